@@ -0,0 +1,262 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+/* Benchmark for the throughput and latency of a device. Frames of a test
+ * pattern are sent as fast as possible, each waiting for the device's
+ * acknowledge, i.e. until the frame has been written to the strip.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ledcontrol.h"
+
+
+/** \brief Get the microseconds of a monotonic clock.
+ *
+ *
+ * \return Microseconds since an arbitrary point in time.
+ */
+static long long
+now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/** \brief Render frame \p n of a test pattern.
+ *
+ * \details The patterns favor different encodings: "chase" changes a few LEDs
+ *  per frame only (PATCH), "blocks" has long runs of equal colors (RLE) and
+ *  "rainbow" changes all LEDs (SET).
+ *
+ *
+ * \param pattern Name of the pattern.
+ * \param colors Destination for the colors of all LEDs.
+ * \param leds Number of LEDs.
+ * \param channels Number of color channels.
+ * \param n Frame number.
+ *
+ * \return On success 0, or -1 for an unknown pattern.
+ */
+static int
+render(const char *pattern, uint8_t *colors, uint16_t leds, uint8_t channels,
+       unsigned int n)
+{
+	memset(colors, 0, leds * channels);
+
+	uint16_t i;
+	if (strcmp(pattern, "chase") == 0) {
+		for (i = 0; i < 4; i++)
+			colors[((n + i * leds / 4) % leds) * channels + 1] = 255;
+	} else if (strcmp(pattern, "blocks") == 0) {
+		for (i = 0; i < leds; i++)
+			colors[i * channels + ((i + n) / 16) % 3] = 255;
+	} else if (strcmp(pattern, "rainbow") == 0) {
+		for (i = 0; i < leds; i++) {
+			uint8_t h = (i * 256 / leds + n) & 0xFF;
+			uint8_t *c = colors + i * channels;
+			c[0] = (h < 128) ? h * 2 : 255 - (h - 128) * 2;
+			c[1] = 255 - c[0];
+			c[2] = h;
+		}
+	} else
+		return -1;
+
+	return 0;
+}
+
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  -d device    serial port (default: /dev/ttyUSB0)\n"
+	        "  -b baud      baud rate (default: 250000)\n"
+	        "  -n leds      number of LEDs (default: 94)\n"
+	        "  -c channels  color channels, 3 or 4 (default: 3)\n"
+	        "  -a address   address of the device (default: none)\n"
+	        "  -f frames    number of frames (default: 1000)\n"
+	        "  -p pattern   chase, blocks or rainbow (default: chase)\n"
+	        "  -e encoding  auto, set, rle or patch (default: auto)\n"
+	        "  -F flow      none, rts or credit (default: credit with an\n"
+	        "               address, otherwise none)\n"
+	        "  -w ms        wait for the device to reset (default: 2000)\n",
+	        name);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	const char *device = "/dev/ttyUSB0", *pattern = "chase";
+	unsigned int baud = 250000, frames = 1000, reset = 2000;
+	int leds = 94, channels = 3, address = LEDCONTROL_HOST_UNADDRESSED;
+	enum ledcontrol_host_encoding encoding = LEDCONTROL_HOST_ENCODING_AUTO;
+	enum ledcontrol_host_flow flow = LEDCONTROL_HOST_FLOW_NONE;
+	bool flow_set = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:b:n:c:a:f:p:e:F:w:h")) != -1)
+		switch (opt) {
+			case 'd': device = optarg; break;
+			case 'b': baud = strtoul(optarg, NULL, 0); break;
+			case 'n': leds = strtol(optarg, NULL, 0); break;
+			case 'c': channels = strtol(optarg, NULL, 0); break;
+			case 'a': address = strtol(optarg, NULL, 0); break;
+			case 'f': frames = strtoul(optarg, NULL, 0); break;
+			case 'p': pattern = optarg; break;
+			case 'w': reset = strtoul(optarg, NULL, 0); break;
+
+			case 'e':
+				if (strcmp(optarg, "auto") == 0)
+					encoding = LEDCONTROL_HOST_ENCODING_AUTO;
+				else if (strcmp(optarg, "set") == 0)
+					encoding = LEDCONTROL_HOST_ENCODING_SET;
+				else if (strcmp(optarg, "rle") == 0)
+					encoding = LEDCONTROL_HOST_ENCODING_RLE;
+				else if (strcmp(optarg, "patch") == 0)
+					encoding = LEDCONTROL_HOST_ENCODING_PATCH;
+				else {
+					usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'F':
+				flow_set = true;
+				if (strcmp(optarg, "none") == 0)
+					flow = LEDCONTROL_HOST_FLOW_NONE;
+				else if (strcmp(optarg, "rts") == 0)
+					flow = LEDCONTROL_HOST_FLOW_RTS;
+				else if (strcmp(optarg, "credit") == 0)
+					flow = LEDCONTROL_HOST_FLOW_CREDIT;
+				else {
+					usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			default: usage(argv[0]); return EXIT_FAILURE;
+		}
+
+	if (leds <= 0 || leds > 0xFFFF || frames == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Credit based flow control needs replies of a single device, so it can
+	// only be used by default, if the device is addressed.
+	if (!flow_set && address != LEDCONTROL_HOST_UNADDRESSED)
+		flow = LEDCONTROL_HOST_FLOW_CREDIT;
+
+	int fd = ledcontrol_host_serial_open(device, baud,
+	                                     flow == LEDCONTROL_HOST_FLOW_RTS);
+	if (fd < 0) {
+		perror(device);
+		return EXIT_FAILURE;
+	}
+
+	// Opening the port usually resets Arduino boards, so wait for the
+	// bootloader to start the firmware.
+	usleep(reset * 1000);
+
+	ledcontrol_host host;
+	if (ledcontrol_host_init(&host, fd, channels, leds, address, flow, 1000) <
+	    0) {
+		perror("ledcontrol_host_init");
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	uint8_t *colors = malloc(leds * channels);
+	if (colors == NULL || render(pattern, colors, leds, channels, 0) < 0) {
+		fprintf(stderr, "Unknown pattern '%s'.\n", pattern);
+		ledcontrol_host_close(&host);
+		return EXIT_FAILURE;
+	}
+
+	long long latency_min = -1, latency_max = 0, latency_sum = 0;
+	unsigned long long bytes = 0;
+	unsigned int n, unchanged = 0;
+
+	const long long start = now_us();
+	for (n = 0; n < frames; n++) {
+		render(pattern, colors, leds, channels, n);
+
+		long long t = now_us();
+		if (ledcontrol_host_frame(&host, colors, encoding) < 0)
+			break;
+		bytes += host.out_len;
+		if (ledcontrol_host_flush(&host) < 0)
+			break;
+		int shown = ledcontrol_host_wait(&host, 1000);
+		if (shown < 0)
+			break;
+		if (!shown)
+			unchanged++;
+		t = now_us() - t;
+
+		latency_sum += t;
+		if (latency_min < 0 || t < latency_min)
+			latency_min = t;
+		if (t > latency_max)
+			latency_max = t;
+	}
+	const long long elapsed = now_us() - start;
+
+	if (n < frames)
+		fprintf(stderr, "Frame %u failed: %s\n", n, strerror(errno));
+	if (n == 0) {
+		free(colors);
+		ledcontrol_host_close(&host);
+		return EXIT_FAILURE;
+	}
+
+	printf("frames:     %u (%u unchanged)\n", n, unchanged);
+	printf("fps:        %.1f\n", n * 1e6 / elapsed);
+	printf("latency:    min %.2f ms, avg %.2f ms, max %.2f ms\n",
+	       latency_min / 1e3, latency_sum / 1e3 / n, latency_max / 1e3);
+	printf("bytes:      %.1f per frame, %.1f kbit/s\n", (double)bytes / n,
+	       bytes * 8e3 / elapsed);
+
+	if (ledcontrol_host_query_stats(&host, 1000) == 0) {
+		const uint16_t *s = host.stats;
+		printf("device:     %u frames shown, %u dropped, %u CRC errors, "
+		       "%u buffer overruns, %u USART overruns\n",
+		       s[0], s[1], s[2], s[3], s[4]);
+		printf("timer:      parse %u/%u, render %u/%u, write %u/%u "
+		       "(last/max)\n",
+		       s[5], s[6], s[7], s[8], s[9], s[10]);
+	} else
+		fprintf(stderr, "Query of the device statistics failed: %s\n",
+		        strerror(errno));
+
+	free(colors);
+	ledcontrol_host_close(&host);
+	return (n == frames) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
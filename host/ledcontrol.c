@@ -0,0 +1,1020 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "ledcontrol.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* Size of a CREDIT query, which must always fit into the credits left. */
+#define LEDCONTROL_HOST_QUERY_SIZE 5
+
+/* Overhead of an addressed frame, i.e. its size without payload. Frames
+ * without address are one byte smaller.
+ */
+#define LEDCONTROL_HOST_FRAME_OVERHEAD 5
+
+/* Maximum number of unchanged LEDs between two changed ones, which will be
+ * sent as part of a single PATCH range instead of starting a new range.
+ */
+#define LEDCONTROL_HOST_PATCH_GAP(channels) (3 / (channels))
+
+
+/** \brief Update the CRC-8 used by the protocol (polynomial 0x07).
+ *
+ * \details This is the same algorithm as avr-libc's _crc8_ccitt_update.
+ *
+ *
+ * \param crc Current CRC.
+ * \param data Next byte.
+ *
+ * \return The updated CRC.
+ */
+static uint8_t
+ledcontrol_host_crc8(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+
+	int i;
+	for (i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+
+	return crc;
+}
+
+
+/** \brief Get the milliseconds of a monotonic clock.
+ *
+ *
+ * \return Milliseconds since an arbitrary point in time.
+ */
+static long long
+ledcontrol_host_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/** \brief Make sure the output buffer has space for \p n more bytes.
+ *
+ *
+ * \param host The connection.
+ * \param n Number of bytes to be appended.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_reserve(ledcontrol_host *host, size_t n)
+{
+	if (host->out_len + n <= host->out_size)
+		return 0;
+
+	size_t size = host->out_size ? host->out_size : 256;
+	while (size < host->out_len + n)
+		size *= 2;
+
+	uint8_t *out = realloc(host->out, size);
+	if (out == NULL)
+		return -1;
+
+	host->out = out;
+	host->out_size = size;
+	return 0;
+}
+
+
+/** \brief Write the whole buffer to the serial port.
+ *
+ *
+ * \param host The connection.
+ * \param data The data to be written.
+ * \param len Length of \p data.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_write(ledcontrol_host *host, const uint8_t *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(host->fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		data += n;
+		len -= n;
+		host->written += n;
+	}
+
+	return 0;
+}
+
+
+/** \brief Store a 16 bit value in little endian byte order.
+ *
+ *
+ * \param p Destination.
+ * \param value The value.
+ */
+static void
+ledcontrol_host_u16(uint8_t *p, uint16_t value)
+{
+	p[0] = value & 0xFF;
+	p[1] = value >> 8;
+}
+
+
+/** \brief Initialize a connection.
+ *
+ *
+ * \param host The connection to be initialized.
+ * \param fd File descriptor of the serial port, e.g. opened by \ref
+ *  ledcontrol_host_serial_open.
+ * \param channels Number of color channels of the strip (3 or 4).
+ * \param leds Number of LEDs of the strip.
+ * \param address Address frames are sent to (see \ref
+ *  ledcontrol_host_set_address). It is set before the initial query, so only
+ *  the addressed device replies. Credit based flow control needs the address
+ *  of a single device.
+ * \param flow Flow control to be used.
+ * \param timeout Milliseconds to wait at most for the device's credits, if
+ *  credit based flow control is used. This applies to the initial query and
+ *  to each flush.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_init(ledcontrol_host *host, int fd, uint8_t channels,
+                     uint16_t leds, int address,
+                     enum ledcontrol_host_flow flow, int timeout)
+{
+	if ((channels != 3 && channels != 4) || leds == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(host, 0, sizeof(*host));
+	host->fd = fd;
+	host->flow = flow;
+	host->timeout = timeout;
+	if (ledcontrol_host_set_address(host, address) < 0)
+		return -1;
+	host->channels = channels;
+	host->leds = leds;
+	host->payload_max = LEDCONTROL_HOST_PAYLOAD_MAX;
+
+	host->frame = calloc(leds, channels);
+	if (host->frame == NULL)
+		return -1;
+
+	/* The receive buffer of the device may be smaller than a frame with the
+	 * maximum payload, so each frame followed by a query needs to fit into the
+	 * initial credits. */
+	if (flow == LEDCONTROL_HOST_FLOW_CREDIT) {
+		if (ledcontrol_host_query_credit(host, timeout) < 0)
+			goto error;
+
+		size_t max = host->credit;
+		if (max <= LEDCONTROL_HOST_QUERY_SIZE + LEDCONTROL_HOST_FRAME_OVERHEAD +
+		               2u * channels) {
+			errno = ENOBUFS;
+			goto error;
+		}
+
+		max -= LEDCONTROL_HOST_QUERY_SIZE + LEDCONTROL_HOST_FRAME_OVERHEAD;
+		if (max < host->payload_max)
+			host->payload_max = max;
+	}
+
+	return 0;
+
+error:;
+	int err = errno;
+	free(host->frame);
+	host->frame = NULL;
+	errno = err;
+	return -1;
+}
+
+
+/** \brief Close a connection and its serial port.
+ *
+ *
+ * \param host The connection.
+ */
+void
+ledcontrol_host_close(ledcontrol_host *host)
+{
+	if (host->fd >= 0)
+		close(host->fd);
+	host->fd = -1;
+
+	free(host->frame);
+	free(host->out);
+	host->frame = NULL;
+	host->out = NULL;
+	host->out_len = host->out_size = 0;
+}
+
+
+/** \brief Set the address frames are sent to.
+ *
+ * \details Only devices addressed by their own address reply, so credit based
+ *  flow control can't be used with broadcast and group addresses or without
+ *  address. A device without address would reply to frames without address,
+ *  but the host can't tell whether it is the only device on the bus.
+ *
+ *
+ * \param host The connection.
+ * \param address Address of the device, group or broadcast address, or \ref
+ *  LEDCONTROL_HOST_UNADDRESSED.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_set_address(ledcontrol_host *host, int address)
+{
+	if (address < LEDCONTROL_HOST_UNADDRESSED || address > 0xFF ||
+	    (host->flow == LEDCONTROL_HOST_FLOW_CREDIT &&
+	     (address == LEDCONTROL_HOST_UNADDRESSED || address == 0 ||
+	      address >= 0xF0))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	host->address = address;
+	return 0;
+}
+
+
+/** \brief Encode a frame into \p dst.
+ *
+ *
+ * \param host The connection.
+ * \param dst Destination with space for \p len + 5 bytes.
+ * \param cmd Command identifier.
+ * \param payload Pointer to the payload.
+ * \param len Length of \p payload.
+ *
+ * \return Size of the encoded frame.
+ */
+static size_t
+ledcontrol_host_encode(const ledcontrol_host *host, uint8_t *dst, uint8_t cmd,
+                       const uint8_t *payload, uint8_t len)
+{
+	uint8_t *p = dst;
+	uint8_t crc = 0;
+
+	if (host->address == LEDCONTROL_HOST_UNADDRESSED)
+		*p++ = LEDCONTROL_HOST_SYNC;
+	else {
+		*p++ = LEDCONTROL_HOST_SYNC_ADDRESSED;
+		*p++ = host->address;
+		crc = ledcontrol_host_crc8(crc, host->address);
+	}
+
+	*p++ = cmd;
+	*p++ = len;
+	crc = ledcontrol_host_crc8(crc, cmd);
+	crc = ledcontrol_host_crc8(crc, len);
+
+	while (len--) {
+		crc = ledcontrol_host_crc8(crc, *payload);
+		*p++ = *payload++;
+	}
+	*p++ = crc;
+
+	return p - dst;
+}
+
+
+/** \brief Queue a command.
+ *
+ * \details The command will be appended to the output buffer and sent with the
+ *  next \ref ledcontrol_host_flush.
+ *
+ *
+ * \param host The connection.
+ * \param cmd Command identifier.
+ * \param payload Pointer to the payload.
+ * \param len Length of \p payload.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_command(ledcontrol_host *host, uint8_t cmd,
+                        const uint8_t *payload, size_t len)
+{
+	if (len > host->payload_max) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ledcontrol_host_reserve(host, len + 5) < 0)
+		return -1;
+
+	host->out_len += ledcontrol_host_encode(host, host->out + host->out_len,
+	                                        cmd, payload, len);
+	return 0;
+}
+
+
+/** \brief Queue SET commands for \p n LEDs.
+ *
+ *
+ * \param host The connection.
+ * \param offset Index of the first LED.
+ * \param colors The colors of all \p n LEDs.
+ * \param n Number of LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_encode_set(ledcontrol_host *host, uint16_t offset,
+                           const uint8_t *colors, uint16_t n)
+{
+	const uint16_t max = (host->payload_max - 2) / host->channels;
+	uint8_t payload[LEDCONTROL_HOST_PAYLOAD_MAX];
+
+	while (n > 0) {
+		uint16_t count = (n < max) ? n : max;
+		size_t size = count * host->channels;
+
+		ledcontrol_host_u16(payload, offset);
+		memcpy(payload + 2, colors, size);
+		if (ledcontrol_host_command(host, LEDCONTROL_HOST_SET, payload,
+		                            size + 2) < 0)
+			return -1;
+
+		colors += size;
+		offset += count;
+		n -= count;
+	}
+
+	return 0;
+}
+
+
+/** \brief Queue RLE commands for \p n LEDs.
+ *
+ *
+ * \param host The connection.
+ * \param offset Index of the first LED.
+ * \param colors The colors of all \p n LEDs.
+ * \param n Number of LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_encode_rle(ledcontrol_host *host, uint16_t offset,
+                           const uint8_t *colors, uint16_t n)
+{
+	const uint8_t ch = host->channels;
+	uint8_t payload[LEDCONTROL_HOST_PAYLOAD_MAX];
+	size_t len = 0;
+
+	while (n > 0) {
+		uint16_t count = 1;
+		while (count < n && count < 255 &&
+		       memcmp(colors, colors + count * ch, ch) == 0)
+			count++;
+
+		// Start a new command, if the run doesn't fit into the current one.
+		if (len + 1 + ch > host->payload_max) {
+			if (ledcontrol_host_command(host, LEDCONTROL_HOST_RLE, payload,
+			                            len) < 0)
+				return -1;
+			len = 0;
+		}
+		if (len == 0) {
+			ledcontrol_host_u16(payload, offset);
+			len = 2;
+		}
+
+		payload[len++] = count;
+		memcpy(payload + len, colors, ch);
+		len += ch;
+
+		colors += count * ch;
+		offset += count;
+		n -= count;
+	}
+
+	if (len > 0)
+		return ledcontrol_host_command(host, LEDCONTROL_HOST_RLE, payload, len);
+	return 0;
+}
+
+
+/** \brief Queue PATCH commands for all LEDs changed since the last frame.
+ *
+ *
+ * \param host The connection.
+ * \param colors The colors of all LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_encode_patch(ledcontrol_host *host, const uint8_t *colors)
+{
+	if (!host->frame_valid)
+		return ledcontrol_host_encode_set(host, 0, colors, host->leds);
+
+	const uint8_t ch = host->channels;
+	uint8_t payload[LEDCONTROL_HOST_PAYLOAD_MAX];
+	size_t len = 0;
+
+	uint16_t i = 0;
+	while (i < host->leds) {
+		if (memcmp(colors + i * ch, host->frame + i * ch, ch) == 0) {
+			i++;
+			continue;
+		}
+
+		// Find the end of the range, including short unchanged gaps.
+		uint16_t end = i + 1, gap = 0;
+		while (end + gap < host->leds) {
+			if (memcmp(colors + (end + gap) * ch, host->frame + (end + gap) * ch,
+			           ch) != 0) {
+				end += gap + 1;
+				gap = 0;
+			} else if (++gap > LEDCONTROL_HOST_PATCH_GAP(ch))
+				break;
+		}
+
+		while (i < end) {
+			if (len + 3 + ch > host->payload_max) {
+				if (ledcontrol_host_command(host, LEDCONTROL_HOST_PATCH,
+				                            payload, len) < 0)
+					return -1;
+				len = 0;
+			}
+
+			uint16_t count = (host->payload_max - len - 3) / ch;
+			if (count > end - i)
+				count = end - i;
+			if (count > 255)
+				count = 255;
+
+			ledcontrol_host_u16(payload + len, i);
+			payload[len + 2] = count;
+			memcpy(payload + len + 3, colors + i * ch, count * ch);
+			len += 3 + count * ch;
+			i += count;
+		}
+	}
+
+	if (len > 0)
+		return ledcontrol_host_command(host, LEDCONTROL_HOST_PATCH, payload,
+		                               len);
+	return 0;
+}
+
+
+/** \brief Queue a FILL command.
+ *
+ *
+ * \param host The connection.
+ * \param color The color for all LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_fill(ledcontrol_host *host, const uint8_t *color)
+{
+	host->frame_valid = false;
+	return ledcontrol_host_command(host, LEDCONTROL_HOST_FILL, color,
+	                               host->channels);
+}
+
+
+/** \brief Queue SET commands for consecutive LEDs.
+ *
+ *
+ * \param host The connection.
+ * \param offset Index of the first LED.
+ * \param colors The colors of all \p n LEDs.
+ * \param n Number of LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_set(ledcontrol_host *host, uint16_t offset,
+                    const uint8_t *colors, uint16_t n)
+{
+	host->frame_valid = false;
+	return ledcontrol_host_encode_set(host, offset, colors, n);
+}
+
+
+/** \brief Queue RLE commands for consecutive LEDs.
+ *
+ *
+ * \param host The connection.
+ * \param offset Index of the first LED.
+ * \param colors The colors of all \p n LEDs.
+ * \param n Number of LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_rle(ledcontrol_host *host, uint16_t offset,
+                    const uint8_t *colors, uint16_t n)
+{
+	host->frame_valid = false;
+	return ledcontrol_host_encode_rle(host, offset, colors, n);
+}
+
+
+/** \brief Queue a PALETTE command.
+ *
+ *
+ * \param host The connection.
+ * \param colors The colors of the palette.
+ * \param n Number of colors (up to \ref LEDCONTROL_HOST_PALETTE_SIZE).
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_palette(ledcontrol_host *host, const uint8_t *colors,
+                        uint8_t n)
+{
+	if (n > LEDCONTROL_HOST_PALETTE_SIZE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ledcontrol_host_command(host, LEDCONTROL_HOST_PALETTE, colors,
+	                               n * host->channels);
+}
+
+
+/** \brief Queue PALETTE_SET commands for consecutive LEDs.
+ *
+ *
+ * \param host The connection.
+ * \param offset Index of the first LED.
+ * \param indices Palette indices of all \p n LEDs, one per byte.
+ * \param n Number of LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_palette_set(ledcontrol_host *host, uint16_t offset,
+                            const uint8_t *indices, uint16_t n)
+{
+	const uint16_t max = (host->payload_max - 4) * 2;
+	uint8_t payload[LEDCONTROL_HOST_PAYLOAD_MAX];
+
+	host->frame_valid = false;
+	while (n > 0) {
+		uint16_t count = (n < max) ? n : max;
+
+		ledcontrol_host_u16(payload, offset);
+		ledcontrol_host_u16(payload + 2, count);
+
+		uint16_t i;
+		for (i = 0; i < count; i++) {
+			uint8_t index = indices[i] & 0x0F;
+			if (i & 1)
+				payload[4 + i / 2] |= index;
+			else
+				payload[4 + i / 2] = index << 4;
+		}
+
+		if (ledcontrol_host_command(host, LEDCONTROL_HOST_PALETTE_SET, payload,
+		                            4 + (count + 1) / 2) < 0)
+			return -1;
+
+		indices += count;
+		offset += count;
+		n -= count;
+	}
+
+	return 0;
+}
+
+
+/** \brief Queue PATCH commands for all LEDs changed since the last frame.
+ *
+ * \details If no frame has been sent by \ref ledcontrol_host_frame or this
+ *  function before, or other commands modified the LEDs in between, all LEDs
+ *  will be sent.
+ *
+ *
+ * \param host The connection.
+ * \param colors The colors of all LEDs.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_patch(ledcontrol_host *host, const uint8_t *colors)
+{
+	if (ledcontrol_host_encode_patch(host, colors) < 0)
+		return -1;
+
+	memcpy(host->frame, colors, host->leds * host->channels);
+	host->frame_valid = true;
+	return 0;
+}
+
+
+/** \brief Queue a SHOW command.
+ *
+ *
+ * \param host The connection.
+ * \param ack Whether the device should acknowledge the frame.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_show(ledcontrol_host *host, bool ack)
+{
+	if (!ack)
+		return ledcontrol_host_command(host, LEDCONTROL_HOST_SHOW, NULL, 0);
+
+	uint8_t seq = host->seq + 1;
+	if (ledcontrol_host_command(host, LEDCONTROL_HOST_SHOW, &seq, 1) < 0)
+		return -1;
+
+	host->seq = seq;
+	host->pending = true;
+	host->show_end = host->written + host->out_len;
+	return 0;
+}
+
+
+/** \brief Queue the commands for a whole frame.
+ *
+ *
+ * \param host The connection.
+ * \param colors The colors of all LEDs.
+ * \param encoding Encoding of the frame, but not \ref
+ *  LEDCONTROL_HOST_ENCODING_AUTO.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_encode_frame(ledcontrol_host *host, const uint8_t *colors,
+                             enum ledcontrol_host_encoding encoding)
+{
+	switch (encoding) {
+		case LEDCONTROL_HOST_ENCODING_SET:
+			return ledcontrol_host_encode_set(host, 0, colors, host->leds);
+		case LEDCONTROL_HOST_ENCODING_RLE:
+			return ledcontrol_host_encode_rle(host, 0, colors, host->leds);
+		case LEDCONTROL_HOST_ENCODING_PATCH:
+			return ledcontrol_host_encode_patch(host, colors);
+		default: errno = EINVAL; return -1;
+	}
+}
+
+
+/** \brief Queue a whole frame followed by an acknowledged SHOW command.
+ *
+ * \details With \ref LEDCONTROL_HOST_ENCODING_AUTO, all encodings will be
+ *  tried and the smallest one queued.
+ *
+ *
+ * \param host The connection.
+ * \param colors The colors of all LEDs.
+ * \param encoding Encoding of the frame.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_frame(ledcontrol_host *host, const uint8_t *colors,
+                      enum ledcontrol_host_encoding encoding)
+{
+	if (encoding == LEDCONTROL_HOST_ENCODING_AUTO) {
+		const size_t start = host->out_len;
+		size_t best = (size_t)-1;
+
+		enum ledcontrol_host_encoding e;
+		for (e = LEDCONTROL_HOST_ENCODING_SET;
+		     e <= LEDCONTROL_HOST_ENCODING_PATCH; e++) {
+			if (ledcontrol_host_encode_frame(host, colors, e) < 0)
+				return -1;
+
+			size_t size = host->out_len - start;
+			host->out_len = start;
+			if (size < best) {
+				best = size;
+				encoding = e;
+			}
+		}
+	}
+
+	if (ledcontrol_host_encode_frame(host, colors, encoding) < 0)
+		return -1;
+
+	memcpy(host->frame, colors, host->leds * host->channels);
+	host->frame_valid = true;
+	return ledcontrol_host_show(host, true);
+}
+
+
+/** \brief Handle a reply of the device.
+ *
+ *
+ * \param host The connection.
+ * \param cmd Command identifier of the reply.
+ * \param payload Pointer to the payload.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_host_reply(ledcontrol_host *host, uint8_t cmd,
+                      const uint8_t *payload, uint8_t len)
+{
+	switch (cmd) {
+		case LEDCONTROL_HOST_SHOW:
+			if (len != 4)
+				return;
+			host->acked = payload[0];
+			host->shown = payload[3];
+			if (host->acked != host->seq)
+				break;
+			host->pending = false;
+
+			// The device reports its free buffer space when acknowledging the
+			// last SHOW command. Bytes written after this command may still be
+			// in flight, so they need to be deducted from the credits.
+			if (host->flow == LEDCONTROL_HOST_FLOW_CREDIT) {
+				size_t space = payload[1] | (payload[2] << 8);
+				size_t sent = host->written - host->show_end;
+				host->credit = (space > sent) ? space - sent : 0;
+			}
+			break;
+
+		case LEDCONTROL_HOST_CREDIT:
+			if (len != 2)
+				return;
+			host->credit = payload[0] | (payload[1] << 8);
+			host->credit_pending = false;
+			break;
+
+		case LEDCONTROL_HOST_STATS:
+			if (len != sizeof(host->stats))
+				return;
+
+			size_t i;
+			for (i = 0; i < len / 2; i++)
+				host->stats[i] = payload[2 * i] | (payload[2 * i + 1] << 8);
+			host->stats_pending = false;
+			break;
+	}
+}
+
+
+/** \brief Receive and handle replies of the device.
+ *
+ * \details Bytes not being part of a valid reply, e.g. text printed by the
+ *  device, will be skipped.
+ *
+ *
+ * \param host The connection.
+ * \param timeout Milliseconds to wait for data (-1 to wait forever).
+ *
+ * \return Number of replies handled, or -1 on error and errno will be set.
+ */
+int
+ledcontrol_host_poll(ledcontrol_host *host, int timeout)
+{
+	struct pollfd pfd = {.fd = host->fd, .events = POLLIN};
+	int ret = poll(&pfd, 1, timeout);
+	if (ret <= 0)
+		return (ret < 0 && errno == EINTR) ? 0 : ret;
+
+	ssize_t n = read(host->fd, host->in + host->in_len,
+	                 sizeof(host->in) - host->in_len);
+	if (n < 0)
+		return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+	if (n == 0) {
+		errno = EIO;
+		return -1;
+	}
+	host->in_len += n;
+
+	int replies = 0;
+	size_t pos = 0;
+	while (pos < host->in_len) {
+		const uint8_t *p = host->in + pos;
+		size_t left = host->in_len - pos;
+
+		// Lengths exceeding the maximum payload can't belong to a reply, so
+		// the sync byte was part of other data.
+		if (p[0] != LEDCONTROL_HOST_SYNC ||
+		    (left >= 3 && p[2] > LEDCONTROL_HOST_PAYLOAD_MAX)) {
+			pos++;
+			continue;
+		}
+		if (left < 3 || left < (size_t)p[2] + 4u)
+			break;
+
+		uint8_t crc = 0;
+		size_t i;
+		for (i = 1; i < (size_t)p[2] + 3u; i++)
+			crc = ledcontrol_host_crc8(crc, p[i]);
+
+		// On a CRC mismatch, the sync byte was part of other data, so
+		// resynchronize with the next byte.
+		if (crc != p[p[2] + 3]) {
+			pos++;
+			continue;
+		}
+
+		ledcontrol_host_reply(host, p[1], p + 3, p[2]);
+		replies++;
+		pos += p[2] + 4;
+	}
+
+	memmove(host->in, host->in + pos, host->in_len - pos);
+	host->in_len -= pos;
+	return replies;
+}
+
+
+/** \brief Receive replies until \p pending gets cleared.
+ *
+ *
+ * \param host The connection.
+ * \param pending Flag cleared by \ref ledcontrol_host_reply.
+ * \param timeout Milliseconds to wait at most.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+static int
+ledcontrol_host_await(ledcontrol_host *host, const bool *pending, int timeout)
+{
+	const long long deadline = ledcontrol_host_now() + timeout;
+
+	while (*pending) {
+		long long left = deadline - ledcontrol_host_now();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if (ledcontrol_host_poll(host, left) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/** \brief Wait for the device's acknowledge of the last SHOW command.
+ *
+ *
+ * \param host The connection.
+ * \param timeout Milliseconds to wait at most.
+ *
+ * \return On success 1 if the device has written the strip, or 0 if it skipped
+ *  the unchanged frame. Otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_wait(ledcontrol_host *host, int timeout)
+{
+	if (ledcontrol_host_await(host, &host->pending, timeout) < 0)
+		return -1;
+
+	return host->shown;
+}
+
+
+/** \brief Query the free receive buffer space of the device.
+ *
+ * \details The query will be sent immediately, bypassing commands queued in
+ *  the output buffer. As no data is sent while waiting for the reply, the
+ *  credits reported by the device are exact.
+ *
+ *
+ * \param host The connection.
+ * \param timeout Milliseconds to wait at most for the reply.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_query_credit(ledcontrol_host *host, int timeout)
+{
+	uint8_t query[LEDCONTROL_HOST_QUERY_SIZE];
+	size_t len =
+	    ledcontrol_host_encode(host, query, LEDCONTROL_HOST_CREDIT, NULL, 0);
+
+	host->credit = 0;
+	host->credit_pending = true;
+	if (ledcontrol_host_write(host, query, len) < 0)
+		return -1;
+
+	return ledcontrol_host_await(host, &host->credit_pending, timeout);
+}
+
+
+/** \brief Send all queued commands.
+ *
+ * \details Without credit based flow control, all queued commands will be
+ *  sent with a single write, i.e. usually a single USB transfer for USB serial
+ *  adapters. Otherwise as many whole frames as fit into the device's receive
+ *  buffer will be sent at once, querying new credits in between. The timeout
+ *  given to \ref ledcontrol_host_init limits the time spent waiting for new
+ *  credits.
+ *
+ *
+ * \param host The connection.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_flush(ledcontrol_host *host)
+{
+	if (host->flow != LEDCONTROL_HOST_FLOW_CREDIT) {
+		if (ledcontrol_host_write(host, host->out, host->out_len) < 0)
+			return -1;
+		host->out_len = 0;
+		return 0;
+	}
+
+	const long long deadline = ledcontrol_host_now() + host->timeout;
+	size_t pos = 0;
+	while (pos < host->out_len) {
+		// Collect the frames fitting into the credits, but always keep enough
+		// credits for the next query.
+		size_t len = 0;
+		while (pos + len < host->out_len) {
+			const uint8_t *p = host->out + pos + len;
+			size_t size = (p[0] == LEDCONTROL_HOST_SYNC_ADDRESSED)
+			                  ? p[3] + LEDCONTROL_HOST_FRAME_OVERHEAD
+			                  : p[2] + LEDCONTROL_HOST_FRAME_OVERHEAD - 1;
+			if (len + size + LEDCONTROL_HOST_QUERY_SIZE > host->credit)
+				break;
+			len += size;
+		}
+
+		if (len == 0) {
+			long long left = deadline - ledcontrol_host_now();
+			if (left <= 0) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+			if (ledcontrol_host_query_credit(host, left) < 0)
+				return -1;
+			continue;
+		}
+
+		if (ledcontrol_host_write(host, host->out + pos, len) < 0)
+			return -1;
+		host->credit -= len;
+		pos += len;
+	}
+
+	host->out_len = 0;
+	return 0;
+}
+
+
+/** \brief Query the performance counters of the device.
+ *
+ * \details Queued commands will be sent before the query. The counters will
+ *  be stored in the connection (see STATS in src/command.h for their order).
+ *
+ *
+ * \param host The connection.
+ * \param timeout Milliseconds to wait at most for the reply.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_query_stats(ledcontrol_host *host, int timeout)
+{
+	host->stats_pending = true;
+	if (ledcontrol_host_command(host, LEDCONTROL_HOST_STATS, NULL, 0) < 0 ||
+	    ledcontrol_host_flush(host) < 0)
+		return -1;
+
+	return ledcontrol_host_await(host, &host->stats_pending, timeout);
+}
@@ -0,0 +1,185 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_HOST_H
+#define LEDCONTROL_HOST_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Constants of the binary protocol. These need to match the firmware (see
+ * src/protocol.h and src/command.h).
+ */
+#define LEDCONTROL_HOST_SYNC 0xA5
+#define LEDCONTROL_HOST_SYNC_ADDRESSED 0xA6
+
+#define LEDCONTROL_HOST_FILL 0x01
+#define LEDCONTROL_HOST_SET 0x02
+#define LEDCONTROL_HOST_SHOW 0x04
+#define LEDCONTROL_HOST_BRIGHTNESS 0x05
+#define LEDCONTROL_HOST_RLE 0x09
+#define LEDCONTROL_HOST_PALETTE 0x0A
+#define LEDCONTROL_HOST_PALETTE_SET 0x0B
+#define LEDCONTROL_HOST_PATCH 0x0C
+#define LEDCONTROL_HOST_CREDIT 0x0F
+#define LEDCONTROL_HOST_STATS 0x10
+
+/* Maximum payload of a frame. This must not exceed the firmware's
+ * LEDCONTROL_PROTOCOL_PAYLOAD_MAX.
+ */
+#ifndef LEDCONTROL_HOST_PAYLOAD_MAX
+#define LEDCONTROL_HOST_PAYLOAD_MAX 128
+#endif
+
+/* Number of colors in the palette of the firmware. */
+#define LEDCONTROL_HOST_PALETTE_SIZE 16
+
+/* Address for frames without address, i.e. frames executed by all devices. */
+#define LEDCONTROL_HOST_UNADDRESSED -1
+
+
+/** \brief Flow control used for sending data to the device.
+ */
+enum ledcontrol_host_flow
+{
+	/* No flow control. The host must not send faster than the device parses,
+	 * e.g. by waiting for the acknowledge of each frame. */
+	LEDCONTROL_HOST_FLOW_NONE,
+
+	/* Hardware flow control with the device's RTS line (see UART_RTS_PIN of
+	 * the firmware) connected to the CTS line of the host. */
+	LEDCONTROL_HOST_FLOW_RTS,
+
+	/* Credit based flow control: the host sends no more bytes than the device
+	 * has reported as free receive buffer space and queries the device for new
+	 * credits, if required. */
+	LEDCONTROL_HOST_FLOW_CREDIT,
+};
+
+
+/** \brief Encoding of frames sent by \ref ledcontrol_host_frame.
+ */
+enum ledcontrol_host_encoding
+{
+	/* Choose the smallest of the encodings below. */
+	LEDCONTROL_HOST_ENCODING_AUTO,
+	/* Send all colors with SET commands. */
+	LEDCONTROL_HOST_ENCODING_SET,
+	/* Send all colors run-length encoded with RLE commands. */
+	LEDCONTROL_HOST_ENCODING_RLE,
+	/* Send the colors changed since the last frame with PATCH commands. */
+	LEDCONTROL_HOST_ENCODING_PATCH,
+};
+
+
+/** \brief Connection to a device.
+ *
+ * \details All fields are private and must be accessed by the functions below
+ *  only.
+ */
+typedef struct ledcontrol_host
+{
+	/* File descriptor of the serial port. */
+	int fd;
+	/* Address of the device or LEDCONTROL_HOST_UNADDRESSED. */
+	int address;
+	enum ledcontrol_host_flow flow;
+
+	/* Number of color channels and LEDs of the strip. */
+	uint8_t channels;
+	uint16_t leds;
+
+	/* Maximum payload of the frames sent. */
+	uint8_t payload_max;
+
+	/* Bytes the device may receive without overrunning its receive buffer
+	 * and milliseconds to wait at most for new credits. */
+	uint16_t credit;
+	bool credit_pending;
+	int timeout;
+
+	/* Bytes written to the device in total and up to the end of the last SHOW
+	 * command, for updating the credits from its acknowledge. */
+	size_t written;
+	size_t show_end;
+
+	/* Sequence number of the last SHOW command and the last acknowledged
+	 * one, and whether the acknowledged one has written the strip, i.e. the
+	 * frame has been changed. */
+	uint8_t seq;
+	uint8_t acked;
+	bool pending;
+	bool shown;
+
+	/* Last frame sent to the device for delta encoding. */
+	uint8_t *frame;
+	bool frame_valid;
+
+	/* Buffer for batching frames into a single write. */
+	uint8_t *out;
+	size_t out_len;
+	size_t out_size;
+
+	/* Buffer for replies of the device. */
+	uint8_t in[LEDCONTROL_HOST_PAYLOAD_MAX + 4];
+	size_t in_len;
+
+	/* Last reply to a STATS command (16 bit values in host byte order). */
+	uint16_t stats[11];
+	bool stats_pending;
+} ledcontrol_host;
+
+
+int ledcontrol_host_serial_open(const char *device, unsigned int baud,
+                                bool rtscts);
+
+int ledcontrol_host_init(ledcontrol_host *host, int fd, uint8_t channels,
+                         uint16_t leds, int address,
+                         enum ledcontrol_host_flow flow, int timeout);
+void ledcontrol_host_close(ledcontrol_host *host);
+int ledcontrol_host_set_address(ledcontrol_host *host, int address);
+
+int ledcontrol_host_command(ledcontrol_host *host, uint8_t cmd,
+                            const uint8_t *payload, size_t len);
+int ledcontrol_host_fill(ledcontrol_host *host, const uint8_t *color);
+int ledcontrol_host_set(ledcontrol_host *host, uint16_t offset,
+                        const uint8_t *colors, uint16_t n);
+int ledcontrol_host_rle(ledcontrol_host *host, uint16_t offset,
+                        const uint8_t *colors, uint16_t n);
+int ledcontrol_host_palette(ledcontrol_host *host, const uint8_t *colors,
+                            uint8_t n);
+int ledcontrol_host_palette_set(ledcontrol_host *host, uint16_t offset,
+                                const uint8_t *indices, uint16_t n);
+int ledcontrol_host_patch(ledcontrol_host *host, const uint8_t *colors);
+int ledcontrol_host_show(ledcontrol_host *host, bool ack);
+int ledcontrol_host_frame(ledcontrol_host *host, const uint8_t *colors,
+                          enum ledcontrol_host_encoding encoding);
+
+int ledcontrol_host_flush(ledcontrol_host *host);
+int ledcontrol_host_poll(ledcontrol_host *host, int timeout);
+int ledcontrol_host_wait(ledcontrol_host *host, int timeout);
+int ledcontrol_host_query_credit(ledcontrol_host *host, int timeout);
+int ledcontrol_host_query_stats(ledcontrol_host *host, int timeout);
+
+
+#endif
@@ -0,0 +1,133 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "ledcontrol.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial.h"
+
+
+/** \brief Get the termios constant of a standard baud rate.
+ *
+ *
+ * \param baud The baud rate.
+ *
+ * \return The speed constant or B0, if \p baud is not a standard baud rate.
+ */
+static speed_t
+ledcontrol_host_serial_speed(unsigned int baud)
+{
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+#ifdef B500000
+		case 500000: return B500000;
+#endif
+#ifdef B1000000
+		case 1000000: return B1000000;
+#endif
+		default: return B0;
+	}
+}
+
+
+/** \brief Open a serial port in raw mode.
+ *
+ * \details Non-standard baud rates like the firmware's default of 250000 baud
+ *  are supported on Linux only.
+ *
+ *
+ * \param device Path of the serial port.
+ * \param baud Baud rate.
+ * \param rtscts Enable hardware flow control (see \ref
+ *  LEDCONTROL_HOST_FLOW_RTS).
+ *
+ * \return The file descriptor of the serial port, or -1 on error and errno
+ *  will be set.
+ */
+int
+ledcontrol_host_serial_open(const char *device, unsigned int baud,
+                            bool rtscts)
+{
+	int fd = open(device, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+
+	struct termios tio;
+	if (tcgetattr(fd, &tio) < 0)
+		goto error;
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	if (rtscts)
+		tio.c_cflag |= CRTSCTS;
+	else
+		tio.c_cflag &= ~CRTSCTS;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	speed_t speed = ledcontrol_host_serial_speed(baud);
+	if (speed != B0) {
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+	}
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+		goto error;
+	if (speed == B0 && ledcontrol_host_serial_baud(fd, baud) < 0)
+		goto error;
+
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+
+error:;
+	int err = errno;
+	close(fd);
+	errno = err;
+	return -1;
+}
+
+
+#ifndef __linux__
+/** \brief Set a non-standard baud rate (not supported on this platform).
+ *
+ *
+ * \param fd File descriptor of the serial port.
+ * \param baud Baud rate.
+ *
+ * \return Always -1 with errno set to EINVAL.
+ */
+int
+ledcontrol_host_serial_baud(int fd, unsigned int baud)
+{
+	(void)fd;
+	(void)baud;
+
+	errno = EINVAL;
+	return -1;
+}
+#endif
@@ -0,0 +1,28 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_HOST_SERIAL_H
+#define LEDCONTROL_HOST_SERIAL_H
+
+
+int ledcontrol_host_serial_baud(int fd, unsigned int baud);
+
+
+#endif
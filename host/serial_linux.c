@@ -0,0 +1,51 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+/* This file must not include <termios.h>, as the Linux specific termios2
+ * interface conflicts with it.
+ */
+
+#include "serial.h"
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+
+/** \brief Set a non-standard baud rate.
+ *
+ *
+ * \param fd File descriptor of the serial port.
+ * \param baud Baud rate.
+ *
+ * \return On success 0, otherwise -1 and errno will be set.
+ */
+int
+ledcontrol_host_serial_baud(int fd, unsigned int baud)
+{
+	struct termios2 tio;
+	if (ioctl(fd, TCGETS2, &tio) < 0)
+		return -1;
+
+	tio.c_cflag &= ~CBAUD;
+	tio.c_cflag |= BOTHER;
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+	return ioctl(fd, TCSETS2, &tio);
+}
@@ -0,0 +1,115 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_CHIPSET_H
+#define LEDCONTROL_CHIPSET_H
+
+
+/* Chipset profiles for the LED strip. The profile is selected at build time by
+ * defining LEDCONTROL_CHIPSET_<name>, which is usually done by CMake. If no
+ * profile is selected, WS2812 will be used. Each profile defines:
+ *
+ *  - LEDCONTROL_CHIPSET_T0H: high time of a "0" bit in ns
+ *  - LEDCONTROL_CHIPSET_T1H: high time of a "1" bit in ns
+ *  - LEDCONTROL_CHIPSET_PERIOD: total time of a bit in ns
+ *  - LEDCONTROL_CHIPSET_RESET: low time to latch the data in us
+ *  - LEDCONTROL_CHIPSET_GAP_MAX: maximum low time between two bytes in us,
+ *    which will not latch the data
+ *  - LEDCONTROL_CHIPSET_CHANNELS: number of color channels (3 or 4)
+ *  - LEDCONTROL_CHIPSET_C0 to C3: color channels in the order they are sent
+ */
+#if !defined(LEDCONTROL_CHIPSET_WS2812) &&                                     \
+    !defined(LEDCONTROL_CHIPSET_WS2812B) &&                                    \
+    !defined(LEDCONTROL_CHIPSET_WS2811) &&                                     \
+    !defined(LEDCONTROL_CHIPSET_SK6812) &&                                     \
+    !defined(LEDCONTROL_CHIPSET_SK6812RGBW)
+#define LEDCONTROL_CHIPSET_WS2812
+#endif
+
+#if defined(LEDCONTROL_CHIPSET_WS2812)
+#define LEDCONTROL_CHIPSET_T0H 350
+#define LEDCONTROL_CHIPSET_T1H 900
+#define LEDCONTROL_CHIPSET_PERIOD 1250
+#define LEDCONTROL_CHIPSET_RESET 50
+#define LEDCONTROL_CHIPSET_GAP_MAX 5
+#define LEDCONTROL_CHIPSET_CHANNELS 3
+#define LEDCONTROL_CHIPSET_C0 g
+#define LEDCONTROL_CHIPSET_C1 r
+#define LEDCONTROL_CHIPSET_C2 b
+
+#elif defined(LEDCONTROL_CHIPSET_WS2812B)
+#define LEDCONTROL_CHIPSET_T0H 400
+#define LEDCONTROL_CHIPSET_T1H 800
+#define LEDCONTROL_CHIPSET_PERIOD 1250
+#define LEDCONTROL_CHIPSET_RESET 300
+#define LEDCONTROL_CHIPSET_GAP_MAX 20
+#define LEDCONTROL_CHIPSET_CHANNELS 3
+#define LEDCONTROL_CHIPSET_C0 g
+#define LEDCONTROL_CHIPSET_C1 r
+#define LEDCONTROL_CHIPSET_C2 b
+
+#elif defined(LEDCONTROL_CHIPSET_WS2811)
+#define LEDCONTROL_CHIPSET_T0H 250
+#define LEDCONTROL_CHIPSET_T1H 600
+#define LEDCONTROL_CHIPSET_PERIOD 1250
+#define LEDCONTROL_CHIPSET_RESET 50
+#define LEDCONTROL_CHIPSET_GAP_MAX 5
+#define LEDCONTROL_CHIPSET_CHANNELS 3
+#define LEDCONTROL_CHIPSET_C0 r
+#define LEDCONTROL_CHIPSET_C1 g
+#define LEDCONTROL_CHIPSET_C2 b
+
+#elif defined(LEDCONTROL_CHIPSET_SK6812)
+#define LEDCONTROL_CHIPSET_T0H 300
+#define LEDCONTROL_CHIPSET_T1H 600
+#define LEDCONTROL_CHIPSET_PERIOD 1250
+#define LEDCONTROL_CHIPSET_RESET 80
+#define LEDCONTROL_CHIPSET_GAP_MAX 5
+#define LEDCONTROL_CHIPSET_CHANNELS 3
+#define LEDCONTROL_CHIPSET_C0 g
+#define LEDCONTROL_CHIPSET_C1 r
+#define LEDCONTROL_CHIPSET_C2 b
+
+#elif defined(LEDCONTROL_CHIPSET_SK6812RGBW)
+#define LEDCONTROL_CHIPSET_T0H 300
+#define LEDCONTROL_CHIPSET_T1H 600
+#define LEDCONTROL_CHIPSET_PERIOD 1250
+#define LEDCONTROL_CHIPSET_RESET 80
+#define LEDCONTROL_CHIPSET_GAP_MAX 5
+#define LEDCONTROL_CHIPSET_CHANNELS 4
+#define LEDCONTROL_CHIPSET_C0 g
+#define LEDCONTROL_CHIPSET_C1 r
+#define LEDCONTROL_CHIPSET_C2 b
+#define LEDCONTROL_CHIPSET_C3 w
+#endif
+
+
+/* Maximum deviation of the high times and of the bit period from the values
+ * above in ns, which all supported chipsets tolerate. The backends check their
+ * timing against these limits at compile time.
+ */
+#define LEDCONTROL_CHIPSET_TOLERANCE 150
+#define LEDCONTROL_CHIPSET_PERIOD_TOLERANCE 600
+
+#define LEDCONTROL_CHIPSET_DEVIATION(real, nominal)                            \
+	(((real) > (nominal)) ? ((real) - (nominal)) : ((nominal) - (real)))
+
+
+#endif
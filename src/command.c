@@ -0,0 +1,544 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "command.h"
+
+#include "effect.h"
+#include "framebuffer.h"
+#include "led.h"
+#include "protocol.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include "timer.h"
+#include "uart.h"
+#include "zone.h"
+
+
+/* Colors for palette encoded commands. */
+static rgb palette[LEDCONTROL_COMMAND_PALETTE_SIZE];
+
+/* Sequence number of the last SHOW command, which has not been acknowledged
+ * yet, and whether this command sent a new frame to the strip.
+ */
+static bool ack_pending = false;
+static uint8_t ack_seq;
+static bool ack_shown;
+
+
+/** \brief Decode a color from the payload.
+ *
+ *
+ * \param p Pointer to the color in g, r, b (, w) order.
+ *
+ * \return The decoded color.
+ */
+static inline rgb
+ledcontrol_command_color(const uint8_t *p)
+{
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	rgb color = {.g = p[0], .r = p[1], .b = p[2], .w = p[3]};
+#else
+	rgb color = {.g = p[0], .r = p[1], .b = p[2]};
+#endif
+	return color;
+}
+
+
+/** \brief Decode a 16 bit little endian value from the payload.
+ *
+ *
+ * \param p Pointer to the value.
+ *
+ * \return The decoded value.
+ */
+static inline uint16_t
+ledcontrol_command_u16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+
+/** \brief Set all LEDs to one color.
+ *
+ *
+ * \param payload Pointer to the color.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_fill(const uint8_t *payload, uint8_t len)
+{
+	if (len != LEDCONTROL_COMMAND_COLOR_SIZE)
+		return;
+
+	rgb color = ledcontrol_command_color(payload);
+	ledcontrol_framebuffer_fill(0, ledcontrol_framebuffer_length(), &color);
+}
+
+
+/** \brief Set consecutive LEDs to individual colors.
+ *
+ *
+ * \param payload Pointer to the offset followed by the colors.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_set(const uint8_t *payload, uint8_t len)
+{
+	if (len < 2 || (len - 2) % LEDCONTROL_COMMAND_COLOR_SIZE != 0)
+		return;
+
+	uint16_t offset = ledcontrol_command_u16(payload);
+	for (payload += 2, len -= 2; len > 0;
+	     payload += LEDCONTROL_COMMAND_COLOR_SIZE,
+	     len -= LEDCONTROL_COMMAND_COLOR_SIZE) {
+		rgb color = ledcontrol_command_color(payload);
+		ledcontrol_framebuffer_set(offset++, &color);
+	}
+}
+
+
+/** \brief Set a range of LEDs to one color.
+ *
+ *
+ * \param payload Pointer to offset, count and color.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_fill_range(const uint8_t *payload, uint8_t len)
+{
+	if (len != 4 + LEDCONTROL_COMMAND_COLOR_SIZE)
+		return;
+
+	rgb color = ledcontrol_command_color(payload + 4);
+	ledcontrol_framebuffer_fill(ledcontrol_command_u16(payload),
+	                            ledcontrol_command_u16(payload + 2), &color);
+}
+
+
+/** \brief Set consecutive LEDs to run-length encoded colors.
+ *
+ *
+ * \param payload Pointer to the offset followed by the runs.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_rle(const uint8_t *payload, uint8_t len)
+{
+	const uint8_t run_size = 1 + LEDCONTROL_COMMAND_COLOR_SIZE;
+	if (len < 2 || (len - 2) % run_size != 0)
+		return;
+
+	uint16_t offset = ledcontrol_command_u16(payload);
+	for (payload += 2, len -= 2; len > 0;
+	     payload += run_size, len -= run_size) {
+		rgb color = ledcontrol_command_color(payload + 1);
+		ledcontrol_framebuffer_fill(offset, payload[0], &color);
+		offset += payload[0];
+	}
+}
+
+
+/** \brief Set the palette.
+ *
+ *
+ * \param payload Pointer to the colors.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_palette(const uint8_t *payload, uint8_t len)
+{
+	if (len % LEDCONTROL_COMMAND_COLOR_SIZE != 0 ||
+	    len > LEDCONTROL_COMMAND_PALETTE_SIZE * LEDCONTROL_COMMAND_COLOR_SIZE)
+		return;
+
+	rgb *p = palette;
+	for (; len > 0; payload += LEDCONTROL_COMMAND_COLOR_SIZE,
+	                len -= LEDCONTROL_COMMAND_COLOR_SIZE)
+		*p++ = ledcontrol_command_color(payload);
+}
+
+
+/** \brief Set consecutive LEDs to colors of the palette.
+ *
+ *
+ * \param payload Pointer to offset and count followed by the indices.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_palette_set(const uint8_t *payload, uint8_t len)
+{
+	if (len < 4)
+		return;
+
+	uint16_t offset = ledcontrol_command_u16(payload);
+	uint16_t count = ledcontrol_command_u16(payload + 2);
+	if (count / 2 + (count & 1) != len - 4)
+		return;
+
+	uint16_t i;
+	for (payload += 4, i = 0; i < count; i++) {
+		uint8_t index = (i & 1) ? (*payload++ & 0x0F) : (*payload >> 4);
+		ledcontrol_framebuffer_set(offset + i, &palette[index]);
+	}
+}
+
+
+/** \brief Set several ranges of LEDs to individual colors.
+ *
+ * \details The whole payload will be validated before modifying any LED, so
+ *  a malformed patch will not be applied partially.
+ *
+ *
+ * \param payload Pointer to the ranges.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_patch(const uint8_t *payload, uint8_t len)
+{
+	const uint8_t *p = payload;
+	uint8_t left = len;
+	while (left > 0) {
+		if (left < 3)
+			return;
+
+		uint16_t size = 3 + p[2] * LEDCONTROL_COMMAND_COLOR_SIZE;
+		if (size > left)
+			return;
+		p += size;
+		left -= size;
+	}
+
+	while (len > 0) {
+		uint16_t offset = ledcontrol_command_u16(payload);
+		uint8_t count = payload[2];
+		for (payload += 3, len -= 3; count > 0; count--) {
+			rgb color = ledcontrol_command_color(payload);
+			ledcontrol_framebuffer_set(offset++, &color);
+			payload += LEDCONTROL_COMMAND_COLOR_SIZE;
+			len -= LEDCONTROL_COMMAND_COLOR_SIZE;
+		}
+	}
+}
+
+
+/** \brief Set the global brightness.
+ *
+ *
+ * \param payload Pointer to the brightness.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_brightness(const uint8_t *payload, uint8_t len)
+{
+	if (len != 1)
+		return;
+
+	if (ledcontrol_zone_current() == LEDCONTROL_ZONE_ALL)
+		ledcontrol_render_set_brightness(payload[0]);
+	else
+		ledcontrol_zone_set_brightness(payload[0]);
+	ledcontrol_framebuffer_refresh();
+}
+
+
+/** \brief Set the white balance.
+ *
+ *
+ * \param payload Pointer to the factor of each channel.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_balance(const uint8_t *payload, uint8_t len)
+{
+	if (len != LEDCONTROL_COMMAND_COLOR_SIZE)
+		return;
+
+	rgb balance = ledcontrol_command_color(payload);
+	ledcontrol_render_set_balance(&balance);
+	ledcontrol_framebuffer_refresh();
+}
+
+
+/** \brief Set the frame rate.
+ *
+ *
+ * \param payload Pointer to the frame rate.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_frame_rate(const uint8_t *payload, uint8_t len)
+{
+	if (len != 1)
+		return;
+
+	timer_set_rate(payload[0]);
+}
+
+
+/** \brief Crossfade to the modified frame.
+ *
+ *
+ * \param payload Pointer to the duration.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_crossfade(const uint8_t *payload, uint8_t len)
+{
+	if (len != 2)
+		return;
+
+	ledcontrol_framebuffer_crossfade(ledcontrol_command_u16(payload));
+}
+
+
+/** \brief Configure the strip.
+ *
+ *
+ * \param payload Pointer to the number of LEDs and the pin mask.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_config(const uint8_t *payload, uint8_t len)
+{
+	if (len != 3)
+		return;
+
+	if (ledcontrol_led_configure(ledcontrol_command_u16(payload), payload[2]))
+		ledcontrol_framebuffer_refresh();
+}
+
+
+/** \brief Stream colors directly to the strip.
+ *
+ *
+ * \param payload Pointer to the number of raw bytes.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_stream(const uint8_t *payload, uint8_t len)
+{
+	if (len != 2)
+		return;
+
+	ledcontrol_framebuffer_stream(ledcontrol_command_u16(payload));
+}
+
+
+/** \brief Show the modified frame.
+ *
+ * \details If the payload contains a sequence number, it will be acknowledged
+ *  by \ref ledcontrol_command_acknowledge.
+ *
+ *
+ * \param payload Pointer to the optional sequence number.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_show(const uint8_t *payload, uint8_t len)
+{
+	if (len > 1)
+		return;
+
+	// Devices addressed together update their strips right away instead of
+	// waiting for their next frame, so they don't differ by up to one frame.
+	bool shown = ledcontrol_framebuffer_show();
+	if (ledcontrol_protocol_multicast())
+		ledcontrol_framebuffer_output();
+
+	if (len == 1 && ledcontrol_protocol_may_reply()) {
+		ack_seq = payload[0];
+		ack_shown = shown;
+		ack_pending = true;
+	}
+}
+
+
+/** \brief Reply with the free receive buffer space.
+ *
+ *
+ * \param len Length of the payload.
+ */
+static void
+ledcontrol_command_credit(uint8_t len)
+{
+	if (len != 0 || !ledcontrol_protocol_may_reply())
+		return;
+
+	uint16_t space = uart_space();
+	uint8_t reply[2] = {space & 0xFF, space >> 8};
+	ledcontrol_protocol_send(LEDCONTROL_COMMAND_CREDIT, reply, sizeof(reply));
+}
+
+
+/** \brief Acknowledge the last SHOW command.
+ *
+ * \details This function should be called after each frame. If a SHOW command
+ *  with a sequence number has been received, the reply will be sent now, so
+ *  the host knows the frame has been sent to the strip, whether the strip has
+ *  been written at all and how many bytes it may send without overrunning the
+ *  receive buffer.
+ */
+void
+ledcontrol_command_acknowledge()
+{
+	if (!ack_pending)
+		return;
+	ack_pending = false;
+
+	uint16_t space = uart_space();
+	uint8_t reply[4] = {ack_seq, space & 0xFF, space >> 8, ack_shown};
+	ledcontrol_protocol_send(LEDCONTROL_COMMAND_SHOW, reply, sizeof(reply));
+}
+
+
+/** \brief Execute a command for a single zone.
+ *
+ *
+ * \param payload Pointer to the zone ID, followed by the command identifier
+ *  and the command's payload.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_zone(const uint8_t *payload, uint8_t len)
+{
+	if (len < 2 || payload[1] == LEDCONTROL_COMMAND_ZONE)
+		return;
+
+	if (ledcontrol_zone_select(payload[0]))
+		ledcontrol_command_execute(payload[1], payload + 2, len - 2);
+	ledcontrol_zone_select(LEDCONTROL_ZONE_ALL);
+}
+
+
+/** \brief Define a zone and store it in EEPROM.
+ *
+ *
+ * \param payload Pointer to zone ID, start, length and flags.
+ * \param len Length of \p payload.
+ */
+static void
+ledcontrol_command_zone_config(const uint8_t *payload, uint8_t len)
+{
+	if (len != 6)
+		return;
+
+	ledcontrol_zone zone = {.start = ledcontrol_command_u16(payload + 1),
+	                        .length = ledcontrol_command_u16(payload + 3),
+	                        .flags = payload[5]};
+	ledcontrol_zone_configure(payload[0], &zone);
+}
+
+
+/** \brief Execute command \p cmd.
+ *
+ * \details Commands will be executed only after the whole frame has been
+ *  received and verified, so \p payload is always complete. Unknown commands
+ *  and commands with an invalid payload will be ignored.
+ *
+ *
+ * \param cmd Command identifier.
+ * \param payload Pointer to the command's payload.
+ * \param len Length of \p payload.
+ */
+void
+ledcontrol_command_execute(uint8_t cmd, const uint8_t *payload, uint8_t len)
+{
+	switch (cmd) {
+		case LEDCONTROL_COMMAND_FILL:
+			ledcontrol_command_fill(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_SET:
+			ledcontrol_command_set(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_FILL_RANGE:
+			ledcontrol_command_fill_range(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_SHOW:
+			ledcontrol_command_show(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_BRIGHTNESS:
+			ledcontrol_command_brightness(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_EFFECT:
+			ledcontrol_effect_set(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_FRAME_RATE:
+			ledcontrol_command_frame_rate(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_CROSSFADE:
+			ledcontrol_command_crossfade(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_RLE:
+			ledcontrol_command_rle(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_PALETTE:
+			ledcontrol_command_palette(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_PALETTE_SET:
+			ledcontrol_command_palette_set(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_PATCH:
+			ledcontrol_command_patch(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_CONFIG:
+			ledcontrol_command_config(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_STREAM:
+			ledcontrol_command_stream(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_CREDIT:
+			ledcontrol_command_credit(len);
+			break;
+		case LEDCONTROL_COMMAND_BALANCE:
+			ledcontrol_command_balance(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_ZONE:
+			ledcontrol_command_zone(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_ZONE_CONFIG:
+			ledcontrol_command_zone_config(payload, len);
+			break;
+		case LEDCONTROL_COMMAND_STATS:
+			if (len == 0 && ledcontrol_protocol_may_reply())
+				ledcontrol_stats_report();
+			break;
+		case LEDCONTROL_COMMAND_SCENE_SAVE:
+			if (len == 1)
+				ledcontrol_scene_save(payload[0]);
+			break;
+		case LEDCONTROL_COMMAND_SCENE_RECALL:
+			if (len == 1)
+				ledcontrol_scene_recall(payload[0], 0);
+			else if (len == 3)
+				ledcontrol_scene_recall(payload[0],
+				                        ledcontrol_command_u16(payload + 1));
+			break;
+		case LEDCONTROL_COMMAND_SCENE_DEFAULT:
+			if (len == 1)
+				ledcontrol_scene_set_default(payload[0]);
+			break;
+		case LEDCONTROL_COMMAND_ADDRESS:
+			if (len == 3)
+				ledcontrol_protocol_configure(payload[0],
+				                              ledcontrol_command_u16(payload + 1));
+			break;
+	}
+}
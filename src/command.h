@@ -0,0 +1,168 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_COMMAND_H
+#define LEDCONTROL_COMMAND_H
+
+
+#include <stdint.h>
+
+#include "chipset.h"
+
+
+/* Size of a color in the payload. */
+#define LEDCONTROL_COMMAND_COLOR_SIZE LEDCONTROL_CHIPSET_CHANNELS
+
+/* Number of colors in the palette. */
+#define LEDCONTROL_COMMAND_PALETTE_SIZE 16
+
+
+/* Command identifiers of the binary protocol. Text mode lines will be mapped
+ * to these commands, too. All 16 bit values are sent in little endian byte
+ * order. Colors are always sent as g, r, b, followed by w for chipsets with
+ * four channels (see \ref LEDCONTROL_COMMAND_COLOR_SIZE). Commands modifying
+ * LEDs don't change the strip until a SHOW command has been received. The
+ * strip will then be updated with the next frame.
+ */
+enum ledcontrol_command
+{
+	/* Set all LEDs to one color. Payload: color */
+	LEDCONTROL_COMMAND_FILL = 0x01,
+
+	/* Set consecutive LEDs to individual colors.
+	 * Payload: offset (16 bit), color for each LED */
+	LEDCONTROL_COMMAND_SET = 0x02,
+
+	/* Set a range of LEDs to one color.
+	 * Payload: offset (16 bit), count (16 bit), color */
+	LEDCONTROL_COMMAND_FILL_RANGE = 0x03,
+
+	/* Show the modified frame. If a sequence number is given, the device will
+	 * reply with a SHOW frame after the frame has been sent to the strip. If
+	 * sent to a broadcast or group address, the frame will be sent to the strip
+	 * immediately, so all devices show their frames in sync. If the frame has
+	 * not been modified since the last SHOW, the strip will not be written and
+	 * the reply's status will be 0, otherwise 1.
+	 * Payload: none or sequence number
+	 * Reply: sequence number, free receive buffer space (16 bit), status */
+	LEDCONTROL_COMMAND_SHOW = 0x04,
+
+	/* Set the global brightness and refresh the strip with the next frame.
+	 * Payload: brightness (255 is full brightness) */
+	LEDCONTROL_COMMAND_BRIGHTNESS = 0x05,
+
+	/* Select an effect of the effect engine.
+	 * Payload: effect, speed, size, color (see ledcontrol_effect_set) */
+	LEDCONTROL_COMMAND_EFFECT = 0x06,
+
+	/* Set the frame rate. Payload: frame rate in Hz */
+	LEDCONTROL_COMMAND_FRAME_RATE = 0x07,
+
+	/* Crossfade to the modified frame instead of showing it immediately.
+	 * Payload: duration in frames (16 bit) */
+	LEDCONTROL_COMMAND_CROSSFADE = 0x08,
+
+	/* Set consecutive LEDs to run-length encoded colors.
+	 * Payload: offset (16 bit), (count, color) for each run */
+	LEDCONTROL_COMMAND_RLE = 0x09,
+
+	/* Set the palette for PALETTE_SET, starting at index 0.
+	 * Payload: up to LEDCONTROL_COMMAND_PALETTE_SIZE colors */
+	LEDCONTROL_COMMAND_PALETTE = 0x0A,
+
+	/* Set consecutive LEDs to colors of the palette. Indices are 4 bit, two
+	 * per byte with the high nibble first.
+	 * Payload: offset (16 bit), count (16 bit), (count + 1) / 2 bytes */
+	LEDCONTROL_COMMAND_PALETTE_SET = 0x0B,
+
+	/* Set several ranges of LEDs to individual colors. As the back buffer
+	 * always holds the frame being shown, only changed LEDs need to be sent.
+	 * Payload: (offset (16 bit), count, color for each LED) for each range */
+	LEDCONTROL_COMMAND_PATCH = 0x0C,
+
+	/* Configure the strip and store the configuration in EEPROM.
+	 * Payload: number of LEDs (16 bit), pin mask */
+	LEDCONTROL_COMMAND_CONFIG = 0x0D,
+
+	/* Forward the following bytes directly to the strip without buffering.
+	 * The raw bytes need to be in the chipset's order of the color channels.
+	 * This needs a baud rate fitting the strip's timing, otherwise the bytes
+	 * will be discarded (see ledcontrol_framebuffer_stream). The payload counts
+	 * bytes instead of LEDs, so devices with other chipsets skip the raw bytes
+	 * of a STREAM addressed to another device, too.
+	 * Payload: number of raw bytes (16 bit) */
+	LEDCONTROL_COMMAND_STREAM = 0x0E,
+
+	/* Query the free receive buffer space, i.e. the number of bytes the host
+	 * may send without waiting for the device.
+	 * Payload: none
+	 * Reply: free receive buffer space (16 bit) */
+	LEDCONTROL_COMMAND_CREDIT = 0x0F,
+
+	/* Query the performance counters. Times are in timer counts (see
+	 * TIMER_COUNTS) for parsing, rendering and writing the strip, the latter
+	 * being the time interrupts are disabled.
+	 * Payload: none
+	 * Reply: frames shown, frames dropped, CRC errors, receive buffer
+	 *  overruns, USART overruns, (last time, maximum time) for parsing,
+	 *  rendering and writing, all 16 bit */
+	LEDCONTROL_COMMAND_STATS = 0x10,
+
+	/* Set the white balance, i.e. a factor for each channel, and refresh the
+	 * strip with the next frame.
+	 * Payload: color (255 leaves a channel unmodified) */
+	LEDCONTROL_COMMAND_BALANCE = 0x11,
+
+	/* Execute a command for a single zone. Offsets of the command are relative
+	 * to the zone, an effect runs in the zone only and BRIGHTNESS sets the
+	 * zone's brightness. Zone 0 is the whole strip.
+	 * Payload: zone ID, command, payload of the command */
+	LEDCONTROL_COMMAND_ZONE = 0x12,
+
+	/* Define a zone and store it in EEPROM. A length of zero undefines the
+	 * zone. Payload: zone ID (1 to LEDCONTROL_ZONE_MAX), start (16 bit),
+	 * length (16 bit), flags (see LEDCONTROL_ZONE_REVERSE) */
+	LEDCONTROL_COMMAND_ZONE_CONFIG = 0x13,
+
+	/* Set the bus address and groups of the device and store them in EEPROM.
+	 * Payload: address (1 to LEDCONTROL_PROTOCOL_DEVICE_MAX), groups (16 bit,
+	 *  bit n for group n) */
+	LEDCONTROL_COMMAND_ADDRESS = 0x14,
+
+	/* Store the frame shown, the brightness and the effect as scene in EEPROM.
+	 * Payload: scene ID (0 to LEDCONTROL_SCENE_MAX - 1) */
+	LEDCONTROL_COMMAND_SCENE_SAVE = 0x15,
+
+	/* Recall a scene, optionally crossfading to it.
+	 * Payload: scene ID, optional duration in frames (16 bit) */
+	LEDCONTROL_COMMAND_SCENE_RECALL = 0x16,
+
+	/* Set the scene recalled at power on.
+	 * Payload: scene ID or LEDCONTROL_SCENE_NONE */
+	LEDCONTROL_COMMAND_SCENE_DEFAULT = 0x17,
+};
+
+
+void ledcontrol_command_execute(uint8_t cmd, const uint8_t *payload,
+                                uint8_t len);
+void ledcontrol_command_acknowledge();
+
+
+#endif
@@ -0,0 +1,37 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "config.h"
+
+#include "led.h"
+
+
+/** \brief Configuration stored in EEPROM.
+ *
+ * \details These defaults will be written only, if the EEPROM is programmed
+ *  with the firmware's EEPROM image.
+ */
+ledcontrol_config ledcontrol_eeprom EEMEM = {
+    .led_count = LEDCONTROL_LED_MAX,
+    .led_pinmask = LEDCONTROL_LED_PINMASK,
+    .address = 0xFF,
+    .groups = 0,
+    .default_scene = LEDCONTROL_SCENE_NONE,
+};
@@ -0,0 +1,80 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_CONFIG_H
+#define LEDCONTROL_CONFIG_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <avr/eeprom.h>
+
+#include "scene.h"
+#include "zone.h"
+
+
+/** \brief Layout of the configuration in EEPROM.
+ *
+ * \details New fields must be inserted right before the scenes, so the fields
+ *  in front of them keep their offsets and configurations stored by previous
+ *  firmware versions stay valid. The scenes must always be the last field, as
+ *  their size depends on the build configuration. Erased EEPROM cells read as
+ *  0xFF, so all fields need to be validated after reading them.
+ */
+typedef struct ledcontrol_config
+{
+	/* Number of LEDs in the strip. */
+	uint16_t led_count;
+	/* Pin mask of the strip (bit-banging backend with a single strip only). */
+	uint8_t led_pinmask;
+	/* Zones of the strip, see ledcontrol_zone_configure. */
+	ledcontrol_zone zones[LEDCONTROL_ZONE_MAX];
+	/* Bus address of the device and its groups (bit n for group n). */
+	uint8_t address;
+	uint16_t groups;
+	/* Scene recalled at power on (see ledcontrol_scene_set_default). */
+	uint8_t default_scene;
+	/* Stored scenes, which must always be the last field. */
+	ledcontrol_scene scenes[LEDCONTROL_SCENE_MAX];
+} ledcontrol_config;
+
+// No field may follow the scenes, i.e. only padding may be left behind them.
+#define LEDCONTROL_CONFIG_SCENES_END                                           \
+	(offsetof(ledcontrol_config, scenes) +                                     \
+	 sizeof(((ledcontrol_config *)0)->scenes))
+_Static_assert(sizeof(ledcontrol_config) - LEDCONTROL_CONFIG_SCENES_END <
+                   __alignof__(ledcontrol_config),
+               "Config: The scenes must be the last field.");
+
+
+// Estimate the size of the configuration, so it is checked before linking.
+#if defined(E2END) &&                                                          \
+    (64 + LEDCONTROL_SCENE_MAX *                                               \
+              (LEDCONTROL_LED_MAX * LEDCONTROL_CHIPSET_CHANNELS + 16)) >       \
+        E2END + 1
+#error "Config: The scenes don't fit into the EEPROM, reduce LEDCONTROL_SCENE_MAX."
+#endif
+
+
+extern ledcontrol_config ledcontrol_eeprom EEMEM;
+
+
+#endif
@@ -0,0 +1,252 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "effect.h"
+
+#include "command.h"
+#include "framebuffer.h"
+#include "led.h"
+#include "zone.h"
+
+
+/* Parameters of the current effect. */
+static uint8_t effect = LEDCONTROL_EFFECT_NONE;
+static uint8_t speed;
+static uint8_t size;
+static rgb color;
+static uint8_t zone;
+
+/* Phase of the current effect as 8.8 fixed point value. A full cycle of the
+ * effect takes 65536 / (speed * 16) frames.
+ */
+static uint16_t phase;
+
+
+/** \brief Set the current effect.
+ *
+ * \details The parameters have the following layout:
+ *
+ *   effect | speed | size | color
+ *
+ *  Selecting \ref LEDCONTROL_EFFECT_NONE stops the current effect, leaving the
+ *  framebuffer as is. Invalid parameters will be ignored. The effect will run
+ *  in the zone currently selected.
+ *
+ *
+ * \param params Pointer to the effect's parameters.
+ * \param len Length of \p params.
+ */
+void
+ledcontrol_effect_set(const uint8_t *params, uint8_t len)
+{
+	if (len == 1 && params[0] == LEDCONTROL_EFFECT_NONE) {
+		effect = LEDCONTROL_EFFECT_NONE;
+		return;
+	}
+	if (len != 3 + LEDCONTROL_COMMAND_COLOR_SIZE ||
+	    params[0] > LEDCONTROL_EFFECT_RAINBOW)
+		return;
+
+	effect = params[0];
+	speed = params[1];
+	size = params[2];
+	color.g = params[3];
+	color.r = params[4];
+	color.b = params[5];
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	color.w = params[6];
+#endif
+	zone = ledcontrol_zone_current();
+	phase = 0;
+}
+
+
+/** \brief Get the current effect.
+ *
+ *
+ * \param params Pointer to a buffer for the effect's parameters in the layout
+ *  of \ref ledcontrol_effect_set, i.e. 3 + \ref LEDCONTROL_COMMAND_COLOR_SIZE
+ *  bytes.
+ *
+ * \return ID of the zone the effect is running in.
+ */
+uint8_t
+ledcontrol_effect_get(uint8_t *params)
+{
+	params[0] = effect;
+	params[1] = speed;
+	params[2] = size;
+	params[3] = color.g;
+	params[4] = color.r;
+	params[5] = color.b;
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	params[6] = color.w;
+#endif
+
+	return zone;
+}
+
+
+/** \brief Scale \p c by \p level.
+ *
+ *
+ * \param c The color to be scaled.
+ * \param level The scale factor, where 255 means full intensity.
+ *
+ * \return The scaled color.
+ */
+static rgb
+ledcontrol_effect_scale(const rgb *c, uint8_t level)
+{
+	const uint16_t scale = level + 1;
+
+	rgb ret;
+	ret.r = (c->r * scale) >> 8;
+	ret.g = (c->g * scale) >> 8;
+	ret.b = (c->b * scale) >> 8;
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	ret.w = (c->w * scale) >> 8;
+#endif
+
+	return ret;
+}
+
+
+/** \brief Get the color of \p hue on a color wheel.
+ *
+ *
+ * \param hue Position on the color wheel.
+ *
+ * \return The fully saturated color.
+ */
+static rgb
+ledcontrol_effect_wheel(uint8_t hue)
+{
+	rgb ret = {0};
+
+	if (hue < 85) {
+		ret.r = 255 - hue * 3;
+		ret.g = hue * 3;
+	} else if (hue < 170) {
+		hue -= 85;
+		ret.g = 255 - hue * 3;
+		ret.b = hue * 3;
+	} else {
+		hue -= 170;
+		ret.b = 255 - hue * 3;
+		ret.r = hue * 3;
+	}
+
+	return ret;
+}
+
+
+/** \brief Render the fade effect.
+ *
+ *
+ * \param pos Position in the current cycle.
+ */
+static void
+ledcontrol_effect_fade(uint8_t pos)
+{
+	// Triangle wave: fade in for the first half of the cycle, fade out for the
+	// second half.
+	uint8_t level = (pos < 128) ? (pos << 1) : ((255 - pos) << 1);
+
+	rgb c = ledcontrol_effect_scale(&color, level);
+	ledcontrol_framebuffer_fill(0, ledcontrol_framebuffer_length(), &c);
+}
+
+
+/** \brief Render the chase effect.
+ *
+ *
+ * \param pos Position in the current cycle.
+ */
+static void
+ledcontrol_effect_chase(uint8_t pos)
+{
+	const rgb black = {0};
+	const uint16_t len = ledcontrol_framebuffer_length();
+	uint16_t start = ((uint32_t)pos * len) >> 8;
+
+	ledcontrol_framebuffer_fill(0, len, &black);
+	ledcontrol_framebuffer_fill(start, size, &color);
+
+	// Wrap the block around the end of the strip.
+	if (start + size > len)
+		ledcontrol_framebuffer_fill(0, start + size - len, &color);
+}
+
+
+/** \brief Render the rainbow effect.
+ *
+ *
+ * \param pos Position in the current cycle.
+ */
+static void
+ledcontrol_effect_rainbow(uint8_t pos)
+{
+	uint8_t hue = pos;
+
+	const uint16_t len = ledcontrol_framebuffer_length();
+	uint16_t i;
+	for (i = 0; i < len; i++, hue += size) {
+		rgb c = ledcontrol_effect_wheel(hue);
+		ledcontrol_framebuffer_set(i, &c);
+	}
+}
+
+
+/** \brief Advance the current effect by \p ticks frames and render it.
+ *
+ * \details The effect will be rendered into the back buffer of the
+ *  framebuffer, which needs to be shown afterwards. All calculations use
+ *  fixed point integers only.
+ *
+ *
+ * \param ticks Number of frames since the last call.
+ *
+ * \return True if an effect is running, otherwise false.
+ */
+bool
+ledcontrol_effect_tick(uint8_t ticks)
+{
+	if (effect == LEDCONTROL_EFFECT_NONE)
+		return false;
+
+	// Stop the effect, if its zone has been undefined meanwhile.
+	if (!ledcontrol_zone_select(zone)) {
+		effect = LEDCONTROL_EFFECT_NONE;
+		return false;
+	}
+
+	phase += (uint16_t)ticks * speed * 16;
+	uint8_t pos = phase >> 8;
+
+	switch (effect) {
+		case LEDCONTROL_EFFECT_FADE: ledcontrol_effect_fade(pos); break;
+		case LEDCONTROL_EFFECT_CHASE: ledcontrol_effect_chase(pos); break;
+		case LEDCONTROL_EFFECT_RAINBOW: ledcontrol_effect_rainbow(pos); break;
+	}
+
+	ledcontrol_zone_select(LEDCONTROL_ZONE_ALL);
+	return true;
+}
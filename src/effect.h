@@ -0,0 +1,52 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_EFFECT_H
+#define LEDCONTROL_EFFECT_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Effects of the effect engine. */
+enum ledcontrol_effect
+{
+	/* No effect, the framebuffer is controlled by the host. */
+	LEDCONTROL_EFFECT_NONE = 0x00,
+
+	/* Fade all LEDs in and out with the effect's color. */
+	LEDCONTROL_EFFECT_FADE = 0x01,
+
+	/* Move a block of size LEDs with the effect's color along the strip. */
+	LEDCONTROL_EFFECT_CHASE = 0x02,
+
+	/* Rotate a rainbow along the strip, where size is the hue difference
+	 * between two adjacent LEDs. */
+	LEDCONTROL_EFFECT_RAINBOW = 0x03,
+};
+
+
+void ledcontrol_effect_set(const uint8_t *params, uint8_t len);
+uint8_t ledcontrol_effect_get(uint8_t *params);
+bool ledcontrol_effect_tick(uint8_t ticks);
+
+
+#endif
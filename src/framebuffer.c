@@ -0,0 +1,388 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "framebuffer.h"
+
+#include <string.h>
+
+#include "power.h"
+#include "render.h"
+#include "stats.h"
+#include "timer.h"
+#include "uart.h"
+#include "zone.h"
+
+
+/** \brief Front and back buffer with the colors of all LEDs in the strip.
+ *
+ * \details All commands modify the back buffer, while the front buffer holds
+ *  the colors currently shown by the strip. \ref ledcontrol_framebuffer_show
+ *  swaps both buffers and sends the new front buffer to the strip.
+ */
+static rgb buffers[2][LEDCONTROL_LED_MAX];
+static rgb *front = buffers[0];
+static rgb *back = buffers[1];
+
+/* Colors of the front buffer after rendering, as they are sent to the strip,
+ * i.e. in the chipset's order of the color channels.
+ */
+static uint8_t output[LEDCONTROL_LED_MAX * LEDCONTROL_CHIPSET_CHANNELS];
+
+/* Whether the back buffer has been changed since it was shown. As the strip is
+ * dark after power on, the initial black frame needs no refresh.
+ */
+static bool dirty = false;
+
+/* Whether the front buffer needs to be sent to the strip. */
+static bool pending = false;
+
+/* Timestamp of the end of the last frame sent to the strip. */
+static uint16_t last_frame;
+
+/* Position and step per frame of a running crossfade from the front to the back
+ * buffer as 0.16 fixed point values and the number of frames left. If no
+ * crossfade is running, the step is zero.
+ */
+static uint16_t fade_pos;
+static uint16_t fade_step;
+static uint16_t fade_left;
+
+/* Window of the strip, which the offsets of \ref ledcontrol_framebuffer_set and
+ * \ref ledcontrol_framebuffer_fill are relative to. By default, the window
+ * covers the whole strip.
+ */
+static uint16_t window_start = 0;
+static uint16_t window_length = UINT16_MAX;
+static bool window_reverse = false;
+
+
+/** \brief Compare two colors.
+ *
+ *
+ * \return True if \p a and \p b are different, otherwise false.
+ */
+static inline bool
+ledcontrol_framebuffer_differs(const rgb *a, const rgb *b)
+{
+	return memcmp(a, b, sizeof(rgb)) != 0;
+}
+
+
+/** \brief Select the window of the strip for following modifications.
+ *
+ * \details All offsets passed to \ref ledcontrol_framebuffer_set and \ref
+ *  ledcontrol_framebuffer_fill will be relative to the window and modifications
+ *  will be truncated at its end. If the window is reversed, the offsets count
+ *  from the window's end.
+ *
+ *
+ * \param start Index of the window's first LED.
+ * \param length Number of LEDs in the window.
+ * \param reverse Whether the window is reversed.
+ */
+void
+ledcontrol_framebuffer_window(uint16_t start, uint16_t length, bool reverse)
+{
+	window_start = start;
+	window_length = length;
+	window_reverse = reverse;
+}
+
+
+/** \brief Select the whole strip for following modifications.
+ */
+void
+ledcontrol_framebuffer_window_reset()
+{
+	ledcontrol_framebuffer_window(0, UINT16_MAX, false);
+}
+
+
+/** \brief Get the length of the current window.
+ *
+ *
+ * \return Number of LEDs of the current window, which are part of the strip.
+ */
+uint16_t
+ledcontrol_framebuffer_length()
+{
+	if (window_start >= ledcontrol_led_count)
+		return 0;
+
+	uint16_t len = ledcontrol_led_count - window_start;
+	return (window_length < len) ? window_length : len;
+}
+
+
+/** \brief Get the front buffer.
+ *
+ *
+ * \return Pointer to the colors currently shown, \ref LEDCONTROL_LED_MAX
+ *  colors in total.
+ */
+const rgb *
+ledcontrol_framebuffer_front()
+{
+	return front;
+}
+
+
+/** \brief Set the color of a single LED in the back buffer.
+ *
+ *
+ * \param offset Index of the LED in the current window. Indices outside the
+ *  window or the strip will be ignored.
+ * \param color The new color.
+ */
+void
+ledcontrol_framebuffer_set(uint16_t offset, const rgb *color)
+{
+	if (offset >= window_length)
+		return;
+	if (window_reverse)
+		offset = window_length - 1 - offset;
+	offset += window_start;
+	if (offset >= ledcontrol_led_count)
+		return;
+
+	rgb *p = back + offset;
+	if (ledcontrol_framebuffer_differs(p, color)) {
+		*p = *color;
+		dirty = true;
+	}
+}
+
+
+/** \brief Set a range of LEDs in the back buffer to one color.
+ *
+ *
+ * \param offset Index of the first LED in the current window.
+ * \param count Number of LEDs to set. The range will be truncated at the end
+ *  of the window and the strip.
+ * \param color The new color.
+ */
+void
+ledcontrol_framebuffer_fill(uint16_t offset, uint16_t count, const rgb *color)
+{
+	if (offset >= window_length)
+		return;
+	if (count > window_length - offset)
+		count = window_length - offset;
+	if (window_reverse)
+		offset = window_length - offset - count;
+	offset += window_start;
+
+	if (offset >= ledcontrol_led_count)
+		return;
+	if (count > ledcontrol_led_count - offset)
+		count = ledcontrol_led_count - offset;
+
+	rgb *p;
+	for (p = back + offset; count--; p++)
+		if (ledcontrol_framebuffer_differs(p, color)) {
+			*p = *color;
+			dirty = true;
+		}
+}
+
+
+/** \brief Request the front buffer to be sent to the strip again.
+ *
+ * \details This function needs to be called after changing render parameters
+ *  like the brightness. The strip will be updated with the next frame.
+ */
+void
+ledcontrol_framebuffer_refresh()
+{
+	pending = true;
+}
+
+
+/** \brief Send the front buffer to the strip, if requested.
+ *
+ * \details This function should be called once per frame. The front buffer
+ *  will be rendered in a pre-pass and written to the strip with a single call
+ *  of \ref ledcontrol_led_write, so interrupts will be disabled only once per
+ *  frame. Before writing, this function ensures the strip's reset time has
+ *  passed since the previous frame, so the strip latched it.
+ *
+ *
+ * \return True if the frame was sent to the strip, otherwise false.
+ */
+bool
+ledcontrol_framebuffer_output()
+{
+	if (!pending)
+		return false;
+	pending = false;
+
+	if (fade_step) {
+		if (--fade_left == 0) {
+			// The last frame of the crossfade shows its target, so the target
+			// frame becomes the front buffer.
+			ledcontrol_framebuffer_show();
+			pending = false;
+		} else {
+			fade_pos += fade_step;
+			pending = true;
+		}
+	}
+
+	// With temporal dithering, the strip needs to be refreshed with every frame
+	// until there are no residuals left.
+	uint16_t start = timer_now();
+	bool dithering;
+	if (fade_step)
+		dithering = ledcontrol_render_blend(output, front, back, fade_pos >> 8,
+		                                    ledcontrol_led_count);
+	else
+		dithering = ledcontrol_render(output, front, ledcontrol_led_count);
+	if (dithering)
+		pending = true;
+	ledcontrol_zone_render(output);
+	ledcontrol_stats_time(LEDCONTROL_STATS_RENDER, start);
+
+	// One more count is needed, as the timestamps have a resolution of one
+	// timer count.
+	timer_wait(last_frame, TIMER_COUNTS(LEDCONTROL_CHIPSET_RESET) + 1);
+	const uint16_t n = ledcontrol_led_count * LEDCONTROL_CHIPSET_CHANNELS;
+	ledcontrol_power_frame(output, n);
+	uart_pause(true);
+	start = timer_now();
+	ledcontrol_led_write(output, n);
+	ledcontrol_stats_time(LEDCONTROL_STATS_WRITE, start);
+	uart_pause(false);
+	last_frame = timer_now();
+	ledcontrol_power_written(output, n);
+	ledcontrol_stats_frame();
+
+	return true;
+}
+
+
+/** \brief Show the back buffer.
+ *
+ * \details The buffers will be swapped by pointer, and the new front buffer
+ *  will be sent to the strip with the next frame. Afterwards the back buffer
+ *  will be synchronized with the front buffer, so following commands modify
+ *  the frame being shown. If the back buffer has not been changed since the
+ *  last call, the strip will not be written at all.
+ *
+ *
+ * \return True if a new frame will be sent to the strip, otherwise false.
+ */
+bool
+ledcontrol_framebuffer_show()
+{
+	// Showing a new frame finishes any running crossfade.
+	fade_step = 0;
+
+	if (!dirty)
+		return false;
+
+	rgb *tmp = front;
+	front = back;
+	back = tmp;
+	dirty = false;
+
+	memcpy(back, front, sizeof(buffers[0]));
+	pending = true;
+
+	return true;
+}
+
+
+/** \brief Discard all changes of the back buffer.
+ *
+ * \details The back buffer will be synchronized with the front buffer again,
+ *  so all modifications since the last call of \ref ledcontrol_framebuffer_show
+ *  will be lost.
+ */
+void
+ledcontrol_framebuffer_revert()
+{
+	memcpy(back, front, sizeof(buffers[0]));
+	dirty = false;
+}
+
+
+/** \brief Crossfade from the front buffer to the back buffer.
+ *
+ * \details The strip will be faded from the frame currently shown to the back
+ *  buffer over \p frames frames. The step per frame will be calculated once,
+ *  so each frame just needs to blend both buffers. After the crossfade, the
+ *  back buffer will be shown like with \ref ledcontrol_framebuffer_show.
+ *  Modifying the back buffer during the crossfade changes its target.
+ *
+ *
+ * \param frames Duration of the crossfade in frames.
+ */
+void
+ledcontrol_framebuffer_crossfade(uint16_t frames)
+{
+	if (frames <= 1 || !dirty) {
+		ledcontrol_framebuffer_show();
+		return;
+	}
+
+	// The step is rounded down, so the blended frames never overshoot. The
+	// target is shown with the last frame, as counted by fade_left.
+	fade_pos = 0;
+	fade_step = 0xFFFF / frames;
+	fade_left = frames;
+	pending = true;
+}
+
+
+/** \brief Stream colors from the UART directly to the strip.
+ *
+ * \details The next \p n bytes received by the UART will be forwarded to the
+ *  strip without buffering, so the number of LEDs is not limited by the size
+ *  of the framebuffer. The colors need to be sent in the chipset's order of the
+ *  color channels and will not be rendered.
+ *
+ *  As interrupts are disabled while streaming, the UART must deliver the bytes
+ *  slower than the strip consumes them, but with gaps shorter than the
+ *  chipset's maximum gap. This limits streaming to a narrow range of baud
+ *  rates, e.g. 666666 baud for 800 kHz chipsets with a maximum gap of 5 us or
+ *  500000 baud for the WS2812B. With other baud rates, including the default
+ *  of 250000 baud, the bytes will be discarded (see ledcontrol_led_stream).
+ *  At these baud rates, a chunk of a single LED doesn't fit one byte of the
+ *  UART, so chunked output of the framebuffer will be disabled by default (see
+ *  \ref LEDCONTROL_LED_CHUNK). Then bytes received while the strip is written
+ *  need RTS flow control or a host waiting for the acknowledgement of SHOW.
+ *
+ *  The strip will be updated from the front buffer again, with the next call
+ *  of \ref ledcontrol_framebuffer_show or \ref ledcontrol_framebuffer_refresh.
+ *
+ *
+ * \param n Number of bytes to stream.
+ */
+void
+ledcontrol_framebuffer_stream(uint16_t n)
+{
+	timer_wait(last_frame, TIMER_COUNTS(LEDCONTROL_CHIPSET_RESET) + 1);
+	ledcontrol_power_on();
+	uint16_t start = timer_now();
+	ledcontrol_led_stream(n, uart_poll);
+	ledcontrol_stats_time(LEDCONTROL_STATS_WRITE, start);
+	last_frame = timer_now();
+	ledcontrol_stats_frame();
+}
@@ -0,0 +1,47 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_FRAMEBUFFER_H
+#define LEDCONTROL_FRAMEBUFFER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led.h"
+
+
+void ledcontrol_framebuffer_window(uint16_t start, uint16_t length,
+                                   bool reverse);
+void ledcontrol_framebuffer_window_reset();
+uint16_t ledcontrol_framebuffer_length();
+const rgb *ledcontrol_framebuffer_front();
+void ledcontrol_framebuffer_set(uint16_t offset, const rgb *color);
+void ledcontrol_framebuffer_fill(uint16_t offset, uint16_t count,
+                                 const rgb *color);
+void ledcontrol_framebuffer_refresh();
+bool ledcontrol_framebuffer_output();
+bool ledcontrol_framebuffer_show();
+void ledcontrol_framebuffer_revert();
+void ledcontrol_framebuffer_crossfade(uint16_t frames);
+void ledcontrol_framebuffer_stream(uint16_t n);
+
+
+#endif
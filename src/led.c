@@ -27,21 +27,75 @@
 
 #include <stdio.h>
 
+#include <avr/eeprom.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include "config.h"
+#include "uart.h"
 
-#define WS2812_PORTREG PORTB
-#define WS2812_DDRREG DDRB
-#define WS2812_PORT 2
+
+/* Port and pins the strips are connected to. These are usually set by CMake.
+ * If more than one pin is set in the pin mask, one strip is connected to each
+ * of these pins and all strips will be driven in parallel. The framebuffer
+ * will be split into equal parts, one for each strip in ascending pin order.
+ */
+#ifndef LEDCONTROL_LED_PORT
+#define LEDCONTROL_LED_PORT B
+#endif
+
+#define WS2812_CONCAT(a, b) a##b
+#define WS2812_REG(reg, port) WS2812_CONCAT(reg, port)
+#define WS2812_PORTREG WS2812_REG(PORT, LEDCONTROL_LED_PORT)
+#define WS2812_DDRREG WS2812_REG(DDR, LEDCONTROL_LED_PORT)
+#define WS2812_PINMASK ((uint8_t)(LEDCONTROL_LED_PINMASK))
+
+// Number of strips connected to the port
+#define WS2812_BIT(n) ((LEDCONTROL_LED_PINMASK >> (n)) & 1)
+#define WS2812_STRIPS                                                          \
+	(WS2812_BIT(0) + WS2812_BIT(1) + WS2812_BIT(2) + WS2812_BIT(3) +           \
+	 WS2812_BIT(4) + WS2812_BIT(5) + WS2812_BIT(6) + WS2812_BIT(7))
+
+// Pins reserved by other features, which must not be used for the strips: on
+// port D, these are the USART and the optional RTS and power switch pins.
+#define WS2812_PORT_D_D 1
+#if WS2812_REG(WS2812_PORT_D_, LEDCONTROL_LED_PORT)
+#ifdef UART_RTS_PIN
+#define WS2812_RESERVED_RTS _BV(UART_RTS_PIN)
+#else
+#define WS2812_RESERVED_RTS 0
+#endif
+#ifdef LEDCONTROL_POWER_PIN
+#define WS2812_RESERVED_POWER _BV(LEDCONTROL_POWER_PIN)
+#else
+#define WS2812_RESERVED_POWER 0
+#endif
+#define WS2812_RESERVED                                                        \
+	(_BV(PD0) | _BV(PD1) | WS2812_RESERVED_RTS | WS2812_RESERVED_POWER)
+#else
+#define WS2812_RESERVED 0
+#endif
+
+#if WS2812_STRIPS == 0 || LEDCONTROL_LED_PINMASK > 0xFF
+#error "Light_ws2812: LEDCONTROL_LED_PINMASK must select 1 to 8 pins."
+#elif (LEDCONTROL_LED_PINMASK & WS2812_RESERVED) != 0
+#error "Light_ws2812: LEDCONTROL_LED_PINMASK uses the USART, RTS or power pin."
+#elif (LEDCONTROL_LED_MAX % WS2812_STRIPS) != 0
+#error "Light_ws2812: LEDCONTROL_LED_MAX must be a multiple of the strips."
+#endif
 
 // Timing in ns
-#define w_zeropulse 350
-#define w_onepulse 900
-#define w_totalperiod 1250
+#define w_zeropulse LEDCONTROL_CHIPSET_T0H
+#define w_onepulse LEDCONTROL_CHIPSET_T1H
+#define w_totalperiod LEDCONTROL_CHIPSET_PERIOD
 
-// Fixed cycles used by the inner loop
+// Fixed cycles used by the inner loop. In parallel mode, the falling edge for
+// "0" bits is delayed by one more cycle for loading the next bit plane.
+#if WS2812_STRIPS > 1
+#define w_fixedlow 3
+#else
 #define w_fixedlow 2
+#endif
 #define w_fixedhigh 4
 #define w_fixedtotal 8
 
@@ -88,6 +142,97 @@
 #define w3_nops 0
 #endif
 
+// Check the timing resulting from the NOP padding and the fixed cycles of the
+// inner loops against the chipset's limits, so an unsupported F_CPU or chipset
+// fails the build. These checks only re-derive the timing from w_fixedlow,
+// w_fixedhigh and w_fixedtotal, which are counted by hand from the asm loops.
+// Nothing simulates or measures the generated code, so changes of the asm
+// loops need to update these constants.
+#define w_ns(cycles) (((cycles)*1000000UL) / (F_CPU / 1000))
+#define w_realzero w_ns(w1_nops + w_fixedlow)
+#define w_realone w_ns(w1_nops + w2_nops + w_fixedhigh)
+#define w_realtotal w_ns(w1_nops + w2_nops + w3_nops + w_fixedtotal)
+
+#if LEDCONTROL_CHIPSET_DEVIATION(w_realzero, w_zeropulse) >                    \
+    LEDCONTROL_CHIPSET_TOLERANCE
+#error "Light_ws2812: The high time of \"0\" bits exceeds the chipset's limits."
+#elif LEDCONTROL_CHIPSET_DEVIATION(w_realone, w_onepulse) >                    \
+    LEDCONTROL_CHIPSET_TOLERANCE
+#error "Light_ws2812: The high time of \"1\" bits exceeds the chipset's limits."
+#elif LEDCONTROL_CHIPSET_DEVIATION(w_realtotal, w_totalperiod) >               \
+    LEDCONTROL_CHIPSET_PERIOD_TOLERANCE
+#error "Light_ws2812: The bit period exceeds the chipset's limits."
+#endif
+
+// Time in ns the UART needs for a single byte (8n1).
+#define w_uartbyte (1000000000UL / (BAUD / 10))
+
+// Worst case cycles of a gap for servicing the UART. These are counted by hand
+// from the C source of uart_rx_service and uart_rx_receive (see uart.c), not
+// from a disassembly, for the path moving a single byte into the receive
+// buffer: the chunk counter and call (7), checking RXC0 (3), the hardware
+// overrun counter (12), reading UDR0 (2), the full buffer check (7), storing
+// the byte and the head (10), updating RTS (12) and the return (4). The count
+// assumes the compiler inlines uart_rx_receive and uart_rts_update and saves
+// no registers for the call, so changes of these functions or the compiler
+// need a new count. The byte loop around the inner loop costs another 10
+// cycles per byte for loading the next byte or bit plane, counting the bytes
+// and branching, which is counted the same way.
+#define w_gapcycles 57
+#define w_loopcycles 10
+
+// As uart_rx_service moves at most one byte, a chunk including its gap must not
+// take longer than the UART needs for one byte, so the USART's buffer doesn't
+// fill up. The gap must not latch the strip. An eighth is added to both as
+// margin for the hand counted cycles.
+#define w_margin(ns) ((ns) + (ns) / 8)
+#define w_gaptime w_margin(w_ns(w_gapcycles))
+#define w_chunktime(leds)                                                      \
+	w_margin((leds)*LEDCONTROL_CHIPSET_CHANNELS *                              \
+	             (8 * w_realtotal + w_ns(w_loopcycles)) +                      \
+	         w_ns(w_gapcycles))
+
+// Number of LEDs sent between servicing the UART, usually set by CMake. If not
+// set, chunks of a single LED will be used, if they fit the baud rate and the
+// chipset's maximum gap. Otherwise chunked output will be disabled, e.g. at
+// 16 MHz for baud rates above 250000 or for the SK6812RGBW, so the UART needs
+// RTS flow control or the host needs to pause sending while the strip is
+// written.
+#ifndef LEDCONTROL_LED_CHUNK
+#if w_gaptime <= LEDCONTROL_CHIPSET_GAP_MAX * 1000UL &&                        \
+    w_chunktime(1) <= w_uartbyte
+#define LEDCONTROL_LED_CHUNK 1
+#else
+#define LEDCONTROL_LED_CHUNK 0
+#endif
+#endif
+
+#if LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS > 255
+#error "Light_ws2812: LEDCONTROL_LED_CHUNK is too large."
+#elif LEDCONTROL_LED_CHUNK > 0 &&                                              \
+    w_gaptime > LEDCONTROL_CHIPSET_GAP_MAX * 1000UL
+#error "Light_ws2812: The gaps of chunked output would latch the strip."
+#elif LEDCONTROL_LED_CHUNK > 0 &&                                              \
+    w_chunktime(LEDCONTROL_LED_CHUNK) > w_uartbyte
+#error "Light_ws2812: LEDCONTROL_LED_CHUNK is too large for the baud rate."
+#endif
+
+// Streaming forwards each byte as soon as the UART received it, while
+// interrupts are disabled. This works only, if the UART is slower than the
+// strip plus the worst case cycles for polling the UART and calling the byte
+// loop, so the USART's buffer doesn't overflow, but fast enough to keep the
+// gap between two bytes below the chipset's maximum, as the strip would latch
+// otherwise. At 16 MHz, e.g. 666666 baud fit 800 kHz chipsets with a maximum
+// gap of 5 us.
+#define w_streamcycles 48
+#define w_stream_strip (8 * w_realtotal)
+#if w_uartbyte >= w_stream_strip + w_ns(w_streamcycles) &&                     \
+    w_uartbyte <= w_stream_strip + LEDCONTROL_CHIPSET_GAP_MAX * 1000UL
+#define w_stream 1
+#else
+#define w_stream 0
+#endif
+
 #define w_nop1 "nop      \n\t"
 #define w_nop2 "rjmp .+0 \n\t"
 #define w_nop4 w_nop2 w_nop2
@@ -95,11 +240,92 @@
 #define w_nop16 w_nop8 w_nop8
 
 
+/* Number of LEDs in the strip. */
+uint16_t ledcontrol_led_count = LEDCONTROL_LED_MAX;
+
+/* Pins of the strips. Only a single strip may be moved to another pin at
+ * runtime, as the bit planes of parallel strips depend on the pin mask.
+ */
+#if WS2812_STRIPS > 1
+#define pinmask WS2812_PINMASK
+#else
+static uint8_t pinmask = WS2812_PINMASK;
+#endif
+
+
+/** \brief Apply a new configuration.
+ *
+ *
+ * \param count Number of LEDs in the strip. For parallel strips, this must be
+ *  a multiple of the number of strips.
+ * \param mask Pin mask of the strip. Pins reserved by other features (see
+ *  \ref WS2812_RESERVED) will be rejected, so the host can't cut off its own
+ *  connection.
+ *
+ * \return True if the configuration is valid and has been applied, otherwise
+ *  false.
+ */
+static bool
+ledcontrol_led_apply(uint16_t count, uint8_t mask)
+{
+	if (count == 0 || count > LEDCONTROL_LED_MAX ||
+	    (count % WS2812_STRIPS) != 0 || (mask & WS2812_RESERVED))
+		return false;
+
+#if WS2812_STRIPS > 1
+	if (mask != WS2812_PINMASK)
+		return false;
+#else
+	if (mask == 0 || (mask & (mask - 1)) != 0)
+		return false;
+
+	// Release the old pin before enabling the new one.
+	WS2812_DDRREG &= ~pinmask;
+	WS2812_PORTREG &= ~pinmask;
+	pinmask = mask;
+#endif
+
+	// Enable output
+	WS2812_DDRREG |= pinmask;
+	ledcontrol_led_count = count;
+
+	return true;
+}
+
+
+/** \brief Init the strip with the configuration stored in EEPROM.
+ *
+ * \details If the EEPROM holds no valid configuration, the defaults set at
+ *  build time will be used.
+ */
 void
 ledcontrol_led_init()
 {
-	// Enable output
-	WS2812_DDRREG |= _BV(WS2812_PORT);
+	if (!ledcontrol_led_apply(eeprom_read_word(&ledcontrol_eeprom.led_count),
+	                          eeprom_read_byte(&ledcontrol_eeprom.led_pinmask)))
+		ledcontrol_led_apply(LEDCONTROL_LED_MAX, WS2812_PINMASK);
+}
+
+
+/** \brief Configure the strip and store the configuration in EEPROM.
+ *
+ *
+ * \param count Number of LEDs in the strip.
+ * \param mask Pin mask of the strip on \ref LEDCONTROL_LED_PORT.
+ *
+ * \return True if the configuration is valid and has been applied, otherwise
+ *  false.
+ */
+bool
+ledcontrol_led_configure(uint16_t count, uint8_t mask)
+{
+	if (!ledcontrol_led_apply(count, mask))
+		return false;
+
+	eeprom_update_word(&ledcontrol_eeprom.led_count, count);
+	eeprom_update_byte(&ledcontrol_eeprom.led_pinmask, mask);
+
+	return true;
 }
 
 
@@ -170,23 +396,310 @@ ledcontrol_led_sendbyte(const uint8_t data, const uint8_t masklo,
 }
 
 
+#if WS2812_STRIPS > 1
+
+/* Number of LEDs per strip in parallel mode. */
+#define WS2812_STRIP_LEN (LEDCONTROL_LED_MAX / WS2812_STRIPS)
+
+// The bit planes take eight bytes for each byte sent to a strip. Together with
+// the framebuffer (the front, back and output buffers, see framebuffer.c) and
+// the residuals for dithering (see render.c), they need to leave at least 512
+// bytes of SRAM for the UART buffers, the other variables and the stack.
+#define WS2812_PLANES_SIZE (WS2812_STRIP_LEN * LEDCONTROL_CHIPSET_CHANNELS * 8)
+#ifdef LEDCONTROL_DITHER
+#define WS2812_FRAMEBUFFERS 4
+#else
+#define WS2812_FRAMEBUFFERS 3
+#endif
+#define WS2812_FRAMEBUFFER_SIZE                                                \
+	(WS2812_FRAMEBUFFERS * LEDCONTROL_LED_MAX * LEDCONTROL_CHIPSET_CHANNELS)
+#define WS2812_SRAM_RESERVE 512
+#if WS2812_PLANES_SIZE + WS2812_FRAMEBUFFER_SIZE + WS2812_SRAM_RESERVE >       \
+    RAMEND - RAMSTART + 1
+#error "Light_ws2812: The bit planes of the parallel strips don't fit the SRAM."
+#endif
+
+/** \brief Bit planes for parallel output.
+ *
+ * \details Each byte holds the port value for one bit period, i.e. one bit of
+ *  the same byte of all strips. For each color byte sent to the strips, there
+ *  are eight planes starting with the most significant bit. The buffer will
+ *  be filled before interrupts get disabled, so the inner loop just needs to
+ *  write the planes to the port.
+ */
+static uint8_t planes[WS2812_PLANES_SIZE];
+
+
+/** \brief Transpose one byte of all strips into eight bit planes.
+ *
+ *
+ * \param plane Pointer to the first of the eight planes to be filled.
+ * \param data The byte to be sent for each strip.
+ * \param masklo Port value with all strip pins low.
+ *
+ * \return Pointer to the plane following the filled ones.
+ */
+static uint8_t *
+ledcontrol_led_transpose(uint8_t *plane, const uint8_t *data,
+                         const uint8_t masklo)
+{
+	uint8_t bit;
+	for (bit = 0x80; bit; bit >>= 1) {
+		uint8_t value = masklo;
+
+		uint8_t pin, strip = 0;
+		for (pin = 1; pin; pin <<= 1)
+			if (WS2812_PINMASK & pin)
+				if (data[strip++] & bit)
+					value |= pin;
+
+		*plane++ = value;
+	}
+
+	return plane;
+}
+
+
+/** \brief Send eight bit planes, i.e. one byte to each strip in parallel.
+ *
+ *
+ * \param plane Pointer to the planes to be sent.
+ * \param masklo Port value with all strip pins low.
+ * \param maskhi Port value with all strip pins high.
+ *
+ * \return Pointer to the plane following the sent ones.
+ */
+static inline const uint8_t *
+ledcontrol_led_sendplanes(const uint8_t *plane, const uint8_t masklo,
+                          const uint8_t maskhi)
+{
+	uint8_t ctr;
+
+	asm volatile("       ldi   %0,8  \n\t"
+	             "loop%=:            \n\t"
+	             "       out   %2,%3 \n\t"
+#if (w1_nops & 1)
+	             w_nop1
+#endif
+#if (w1_nops & 2)
+	                 w_nop2
+#endif
+#if (w1_nops & 4)
+	                     w_nop4
+#endif
+#if (w1_nops & 8)
+	                         w_nop8
+#endif
+#if (w1_nops & 16)
+	                             w_nop16
+#endif
+	             "       ld    __tmp_reg__,%a1+ \n\t"
+	             "       out   %2,__tmp_reg__   \n\t"
+#if (w2_nops & 1)
+	             w_nop1
+#endif
+#if (w2_nops & 2)
+	                 w_nop2
+#endif
+#if (w2_nops & 4)
+	                     w_nop4
+#endif
+#if (w2_nops & 8)
+	                         w_nop8
+#endif
+#if (w2_nops & 16)
+	                             w_nop16
+#endif
+	             "       out   %2,%4 \n\t"
+#if (w3_nops & 1)
+	             w_nop1
+#endif
+#if (w3_nops & 2)
+	                 w_nop2
+#endif
+#if (w3_nops & 4)
+	                     w_nop4
+#endif
+#if (w3_nops & 8)
+	                         w_nop8
+#endif
+#if (w3_nops & 16)
+	                             w_nop16
+#endif
+
+	             "       dec   %0    \n\t"
+	             "       brne  loop%=\n\t"
+	             : "=&d"(ctr), "+e"(plane)
+	             : "I"(_SFR_IO_ADDR(WS2812_PORTREG)), "r"(maskhi),
+	               "r"(masklo));
+
+	return plane;
+}
+
+
+/** \brief Send \p n bytes to the strips in parallel.
+ *
+ * \details The bytes will be split into equal parts, one for each strip.
+ *  They need to be in the chipset's order of the color channels already. The
+ *  caller needs to ensure the strip's reset time passes between two frames, so
+ *  the strips latch the new colors. With chunked output (see \ref
+ *  LEDCONTROL_LED_CHUNK), the UART receiver will be serviced between the
+ *  chunks.
+ *
+ *
+ * \param data Pointer to the bytes.
+ * \param n Number of bytes to send. Must not exceed the size of the
+ *  framebuffer.
+ */
+void
+ledcontrol_led_write(const uint8_t *data, uint16_t n)
+{
+	const uint16_t len = n / WS2812_STRIPS;
+	if (len == 0 || len > WS2812_STRIP_LEN * LEDCONTROL_CHIPSET_CHANNELS)
+		return;
+
+	uint8_t masklo = ~pinmask & WS2812_PORTREG;
+	uint8_t maskhi = pinmask | WS2812_PORTREG;
+
+	// Transpose the bytes into bit planes, while interrupts are still enabled.
+	uint8_t *plane = planes;
+	uint16_t i;
+	for (i = 0; i < len; i++) {
+		uint8_t bytes[WS2812_STRIPS];
+
+		uint8_t strip;
+		for (strip = 0; strip < WS2812_STRIPS; strip++)
+			bytes[strip] = data[strip * len + i];
+
+		plane = ledcontrol_led_transpose(plane, bytes, masklo);
+	}
+
+	// Save status register and disable interrupts.
+	uint8_t sreg_save = SREG;
+	cli();
+
+	const uint8_t *p = planes;
+#if LEDCONTROL_LED_CHUNK > 0
+	uint8_t chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+#endif
+	while (p < plane) {
+		p = ledcontrol_led_sendplanes(p, masklo, maskhi);
+
+#if LEDCONTROL_LED_CHUNK > 0
+		if (!--chunk) {
+			uart_rx_service();
+			chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+		}
+#endif
+	}
+
+
+	// Reset status register.
+	SREG = sreg_save;
+}
+
+/** \brief Stream \p n bytes from \p source to the strip.
+ *
+ * \details Streaming is not supported for parallel strips, as the bytes would
+ *  need to be transposed. The bytes will be consumed and discarded instead.
+ *
+ *
+ * \param n Number of bytes to stream.
+ * \param source Function returning the next byte, or a negative value if no
+ *  more bytes are available.
+ */
 void
-ledcontrol_led_write(rgb *color, int n)
+ledcontrol_led_stream(uint16_t n, int (*source)())
 {
+	while (n-- && source() >= 0)
+		;
+}
+
+#else
+
+/** \brief Send \p n bytes to the strip.
+ *
+ * \details The bytes need to be in the chipset's order of the color channels
+ *  already, so they can be sent unmodified. The caller needs to ensure the
+ *  strip's reset time passes between two frames, so the strip latches the new
+ *  colors. With chunked output (see \ref LEDCONTROL_LED_CHUNK), the UART
+ *  receiver will be serviced between the chunks.
+ *
+ *
+ * \param data Pointer to the bytes.
+ * \param n Number of bytes to send.
+ */
+void
+ledcontrol_led_write(const uint8_t *data, uint16_t n)
+{
+	if (n == 0)
+		return;
+
 	// Save status register and disable interrupts.
 	uint8_t sreg_save = SREG;
 	cli();
 
-	uint8_t masklo = ~(_BV(WS2812_PORT)) & WS2812_PORTREG;
-	uint8_t maskhi = _BV(WS2812_PORT) | WS2812_PORTREG;
+	uint8_t masklo = ~pinmask & WS2812_PORTREG;
+	uint8_t maskhi = pinmask | WS2812_PORTREG;
 
+#if LEDCONTROL_LED_CHUNK > 0
+	uint8_t chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+#endif
 	do {
-		ledcontrol_led_sendbyte(color->g, masklo, maskhi);
-		ledcontrol_led_sendbyte(color->r, masklo, maskhi);
-		ledcontrol_led_sendbyte(color->b, masklo, maskhi);
+		ledcontrol_led_sendbyte(*data++, masklo, maskhi);
+
+#if LEDCONTROL_LED_CHUNK > 0
+		if (!--chunk) {
+			uart_rx_service();
+			chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+		}
+#endif
 	} while (--n);
 
 
 	// Reset status register.
 	SREG = sreg_save;
 }
+
+
+/** \brief Stream \p n bytes from \p source to the strip.
+ *
+ * \details The bytes will be sent unmodified, i.e. in the chipset's order of
+ *  the color channels, as soon as \p source returns them. Interrupts will be
+ *  disabled while streaming, so \p source needs to poll its hardware. If
+ *  \p source returns a negative value, streaming will be stopped. If the baud
+ *  rate doesn't fit the strip's timing (see \ref w_stream), the bytes will be
+ *  consumed and discarded instead.
+ *
+ *
+ * \param n Number of bytes to stream.
+ * \param source Function returning the next byte, or a negative value if no
+ *  more bytes are available.
+ */
+void
+ledcontrol_led_stream(uint16_t n, int (*source)())
+{
+#if !w_stream
+	while (n-- && source() >= 0)
+		;
+#else
+	// Save status register and disable interrupts.
+	uint8_t sreg_save = SREG;
+	cli();
+
+	uint8_t masklo = ~pinmask & WS2812_PORTREG;
+	uint8_t maskhi = pinmask | WS2812_PORTREG;
+
+	while (n--) {
+		int c = source();
+		if (c < 0)
+			break;
+		ledcontrol_led_sendbyte(c, masklo, maskhi);
+	}
+
+	// Reset status register.
+	SREG = sreg_save;
+#endif
+}
+
+#endif
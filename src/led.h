@@ -22,20 +22,43 @@
 #define LEDCONTROL_LED_H
 
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "chipset.h"
+
+
+/* Maximum number of LEDs in the strip. This is usually set by CMake. The actual
+ * number of LEDs is configured at runtime (see ledcontrol_led_configure).
+ */
+#ifndef LEDCONTROL_LED_MAX
+#define LEDCONTROL_LED_MAX 94
+#endif
+
+/* Default pins of the strips. This is usually set by CMake. */
+#ifndef LEDCONTROL_LED_PINMASK
+#define LEDCONTROL_LED_PINMASK 0x04
+#endif
 
 typedef struct rgb
 {
 	uint8_t r;
 	uint8_t g;
 	uint8_t b;
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	uint8_t w;
+#endif
 } rgb;
 
 
+extern uint16_t ledcontrol_led_count;
+
+
 void ledcontrol_led_init();
-void ledcontrol_led_write(rgb *color, int n);
+bool ledcontrol_led_configure(uint16_t count, uint8_t pinmask);
+void ledcontrol_led_write(const uint8_t *data, uint16_t n);
+void ledcontrol_led_stream(uint16_t n, int (*source)());
 
 
 #endif
@@ -0,0 +1,340 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+/* This is an alternative backend for the LED strip, which uses the SPI
+ * peripheral instead of bit-banging. Each bit of the strip's data is encoded
+ * as a pattern of four SPI bits, so a "0" bit is sent as 1000 and a "1" bit as
+ * 1110. With a SPI clock of 4 MHz, high times are 250 or 750 ns and each bit
+ * takes 1 us. The strip needs to be connected to MOSI (PB3).
+ */
+
+#include "led.h"
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "config.h"
+#include "uart.h"
+
+
+// The SPI patterns have a fixed timing, which matches only chipsets with a bit
+// rate of 800 kHz.
+#if LEDCONTROL_CHIPSET_PERIOD != 1250
+#error "Light_ws2812 SPI: The chipset's bit rate is not supported."
+#endif
+
+// Check the fixed timing of the SPI patterns against the chipset's limits.
+#if LEDCONTROL_CHIPSET_DEVIATION(250, LEDCONTROL_CHIPSET_T0H) >                 \
+        LEDCONTROL_CHIPSET_TOLERANCE ||                                        \
+    LEDCONTROL_CHIPSET_DEVIATION(750, LEDCONTROL_CHIPSET_T1H) >                 \
+        LEDCONTROL_CHIPSET_TOLERANCE ||                                        \
+    LEDCONTROL_CHIPSET_DEVIATION(1000, LEDCONTROL_CHIPSET_PERIOD) >            \
+        LEDCONTROL_CHIPSET_PERIOD_TOLERANCE
+#error "Light_ws2812 SPI: The chipset's timing is not supported."
+#endif
+
+// The strip is always connected to MOSI, so parallel strips can't be driven.
+#if LEDCONTROL_LED_PINMASK == 0 ||                                             \
+    (LEDCONTROL_LED_PINMASK & (LEDCONTROL_LED_PINMASK - 1)) != 0
+#error "Light_ws2812 SPI: LEDCONTROL_LED_PINMASK must select a single pin."
+#endif
+
+// Select the SPI clock divider for a SPI clock of 4 MHz.
+#if F_CPU == 16000000UL
+#define SPI_SPCR 0
+#define SPI_SPSR 0
+#elif F_CPU == 8000000UL
+#define SPI_SPCR 0
+#define SPI_SPSR _BV(SPI2X)
+#else
+#error "Light_ws2812 SPI: Sorry, only F_CPU of 8 or 16 MHz is supported."
+#endif
+
+#define SPI_UARTBYTE (1000000000UL / (BAUD / 10))
+#define SPI_NS(cycles) (((cycles)*1000000UL) / (F_CPU / 1000))
+#define SPI_MARGIN(ns) ((ns) + (ns) / 8)
+
+// Worst case cycles of the receive interrupt, counted by hand from the C source
+// the same way as the gap in led.c: the interrupt response and jump (7), the
+// prologue and epilogue saving SREG and the used registers (30), moving the
+// byte into the receive buffer (43) and the return (4). If this fits the
+// chipset's maximum gap (with an eighth as margin), interrupts will be
+// disabled for single bytes only and the receive interrupt may run between
+// them, e.g. for the WS2812B at 16 MHz. Otherwise interrupts have to be
+// disabled for the whole frame.
+#define SPI_ISRCYCLES 84
+#if SPI_MARGIN(SPI_NS(SPI_ISRCYCLES)) <= LEDCONTROL_CHIPSET_GAP_MAX * 1000UL
+#define SPI_BYTEWISE 1
+#else
+#define SPI_BYTEWISE 0
+#endif
+
+#if !SPI_BYTEWISE
+// Worst case cycles of a gap for servicing the UART and of the byte loop, which
+// are counted by hand the same way as for the asm backend (see led.c). Each
+// byte takes 8 us on SPI. A chunk including its gap must not take longer than
+// the UART needs for one byte, and the gap must not latch the strip, with an
+// eighth added as margin.
+#define SPI_GAPCYCLES 57
+#define SPI_LOOPCYCLES 10
+#define SPI_GAPTIME SPI_MARGIN(SPI_NS(SPI_GAPCYCLES))
+#define SPI_CHUNKTIME(leds)                                                    \
+	SPI_MARGIN((leds)*LEDCONTROL_CHIPSET_CHANNELS *                            \
+	               (8000UL + SPI_NS(SPI_LOOPCYCLES)) +                         \
+	           SPI_NS(SPI_GAPCYCLES))
+
+// If not set at build time, chunks of a single LED will be used, if they fit
+// the baud rate and the chipset's maximum gap, otherwise chunked output will be
+// disabled (see led.c).
+#ifndef LEDCONTROL_LED_CHUNK
+#if SPI_GAPTIME <= LEDCONTROL_CHIPSET_GAP_MAX * 1000UL &&                      \
+    SPI_CHUNKTIME(1) <= SPI_UARTBYTE
+#define LEDCONTROL_LED_CHUNK 1
+#else
+#define LEDCONTROL_LED_CHUNK 0
+#endif
+#endif
+
+#if LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS > 255
+#error "Light_ws2812 SPI: LEDCONTROL_LED_CHUNK is too large."
+#elif LEDCONTROL_LED_CHUNK > 0 &&                                              \
+    SPI_GAPTIME > LEDCONTROL_CHIPSET_GAP_MAX * 1000UL
+#error "Light_ws2812 SPI: The gaps of chunked output would latch the strip."
+#elif LEDCONTROL_LED_CHUNK > 0 &&                                              \
+    SPI_CHUNKTIME(LEDCONTROL_LED_CHUNK) > SPI_UARTBYTE
+#error "Light_ws2812 SPI: LEDCONTROL_LED_CHUNK is too large for the baud rate."
+#endif
+#endif
+
+
+// Streaming works only, if the UART is slower than the strip plus the worst
+// case cycles for polling the UART, but fast enough to keep the gap between two
+// bytes below the chipset's maximum (see led.c). Each byte takes 8 us on SPI.
+#define SPI_STREAMCYCLES 48
+#define SPI_STREAM_STRIP 8000UL
+#if SPI_UARTBYTE >= SPI_STREAM_STRIP + SPI_NS(SPI_STREAMCYCLES) &&             \
+    SPI_UARTBYTE <= SPI_STREAM_STRIP + LEDCONTROL_CHIPSET_GAP_MAX * 1000UL
+#define SPI_STREAM 1
+#else
+#define SPI_STREAM 0
+#endif
+
+
+/** \brief SPI patterns for two bits of the strip's data.
+ *
+ * \details Each byte of the strip will be sent as four SPI bytes, each holding
+ *  two bits of the strip's data, starting with the most significant bits.
+ */
+static const uint8_t symbols[4] = {0x88, 0x8E, 0xE8, 0xEE};
+
+
+/* Number of LEDs in the strip. */
+uint16_t ledcontrol_led_count = LEDCONTROL_LED_MAX;
+
+
+/** \brief Init SPI and the strip with the configuration stored in EEPROM.
+ *
+ * \details If the EEPROM holds no valid configuration, \ref LEDCONTROL_LED_MAX
+ *  LEDs will be used. The pin mask will be ignored, as the strip is always
+ *  connected to MOSI.
+ */
+void
+ledcontrol_led_init()
+{
+	uint16_t count = eeprom_read_word(&ledcontrol_eeprom.led_count);
+	if (count != 0 && count <= LEDCONTROL_LED_MAX)
+		ledcontrol_led_count = count;
+
+	// Enable outputs for MOSI, SCK and SS, which needs to be configured as
+	// output for master mode.
+	DDRB |= _BV(PB3) | _BV(PB5) | _BV(PB2);
+
+	// Enable SPI master mode with MSB first.
+	SPCR = _BV(SPE) | _BV(MSTR) | SPI_SPCR;
+	SPSR = SPI_SPSR;
+}
+
+
+/** \brief Configure the strip and store the configuration in EEPROM.
+ *
+ *
+ * \param count Number of LEDs in the strip.
+ * \param mask Pin mask of the strip. This will be ignored, as the strip is
+ *  always connected to MOSI.
+ *
+ * \return True if the configuration is valid and has been applied, otherwise
+ *  false.
+ */
+bool
+ledcontrol_led_configure(uint16_t count, uint8_t mask)
+{
+	if (count == 0 || count > LEDCONTROL_LED_MAX)
+		return false;
+
+	ledcontrol_led_count = count;
+	eeprom_update_word(&ledcontrol_eeprom.led_count, count);
+
+	return true;
+}
+
+
+/** \brief Send one byte to the strip.
+ *
+ * \details Interrupts need to be disabled by the caller. Between two bytes,
+ *  MOSI stays low, so the caller must not spend more than the chipset's
+ *  maximum gap between them or the strip latches in the middle of a frame.
+ *
+ *
+ * \param data The byte to be sent.
+ */
+static inline void
+ledcontrol_led_sendbyte(uint8_t data)
+{
+	// Look up the SPI patterns first, so the gaps between the SPI bytes are as
+	// short as possible.
+	uint8_t s0 = symbols[data >> 6];
+	uint8_t s1 = symbols[(data >> 4) & 3];
+	uint8_t s2 = symbols[(data >> 2) & 3];
+	uint8_t s3 = symbols[data & 3];
+
+	SPDR = s0;
+	while (!(SPSR & _BV(SPIF)))
+		;
+	SPDR = s1;
+	while (!(SPSR & _BV(SPIF)))
+		;
+	SPDR = s2;
+	while (!(SPSR & _BV(SPIF)))
+		;
+	SPDR = s3;
+	while (!(SPSR & _BV(SPIF)))
+		;
+}
+
+
+/** \brief Send \p n bytes to the strip.
+ *
+ * \details The bytes need to be in the chipset's order of the color channels
+ *  already, so they can be sent unmodified. The caller needs to ensure the
+ *  strip's reset time passes between two frames, so the strip latches the new
+ *  colors.
+ *
+ *  If the receive interrupt fits the strip's maximum gap (see \ref
+ *  SPI_BYTEWISE), interrupts will be disabled for single bytes only. The
+ *  transmit and timer interrupts, which may take longer, will be masked for
+ *  the whole frame, so only the receive interrupt runs between two bytes.
+ *  Otherwise interrupts will be disabled for the whole frame and with chunked
+ *  output (see \ref LEDCONTROL_LED_CHUNK), the UART receiver will be serviced
+ *  between the chunks.
+ *
+ *
+ * \param data Pointer to the bytes.
+ * \param n Number of bytes to send.
+ */
+void
+ledcontrol_led_write(const uint8_t *data, uint16_t n)
+{
+	if (n == 0)
+		return;
+
+	// Save status register and disable interrupts.
+	uint8_t sreg_save = SREG;
+	cli();
+
+#if SPI_BYTEWISE
+	// Mask all interrupts but the receive interrupt for the whole frame. As the
+	// transmit interrupt is only enabled by the main loop, it doesn't change
+	// while writing the strip.
+	uint8_t udrie_save = UCSR0B & _BV(UDRIE0);
+	uint8_t ocie_save = TIMSK1 & _BV(OCIE1A);
+	UCSR0B &= ~_BV(UDRIE0);
+	TIMSK1 &= ~_BV(OCIE1A);
+
+	do {
+		ledcontrol_led_sendbyte(*data++);
+
+		// Let the receive interrupt run between two bytes. A pending interrupt
+		// will be serviced only after the instruction following the one that
+		// enabled interrupts, so a NOP is needed before disabling them again.
+		SREG = sreg_save;
+		asm volatile("nop");
+		cli();
+	} while (--n);
+
+	UCSR0B |= udrie_save;
+	TIMSK1 |= ocie_save;
+#else
+#if LEDCONTROL_LED_CHUNK > 0
+	uint8_t chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+#endif
+	do {
+		ledcontrol_led_sendbyte(*data++);
+
+#if LEDCONTROL_LED_CHUNK > 0
+		if (!--chunk) {
+			uart_rx_service();
+			chunk = LEDCONTROL_LED_CHUNK * LEDCONTROL_CHIPSET_CHANNELS;
+		}
+#endif
+	} while (--n);
+#endif
+
+	// Reset status register.
+	SREG = sreg_save;
+}
+
+
+/** \brief Stream \p n bytes from \p source to the strip.
+ *
+ * \details The bytes will be sent unmodified, i.e. in the chipset's order of
+ *  the color channels, as soon as \p source returns them. Interrupts will be
+ *  disabled while streaming, so \p source needs to poll its hardware. If
+ *  \p source returns a negative value, streaming will be stopped. If the baud
+ *  rate doesn't fit the strip's timing (see \ref SPI_STREAM), the bytes will
+ *  be consumed and discarded instead.
+ *
+ *
+ * \param n Number of bytes to stream.
+ * \param source Function returning the next byte, or a negative value if no
+ *  more bytes are available.
+ */
+void
+ledcontrol_led_stream(uint16_t n, int (*source)())
+{
+#if !SPI_STREAM
+	while (n-- && source() >= 0)
+		;
+#else
+	// Save status register and disable interrupts.
+	uint8_t sreg_save = SREG;
+	cli();
+
+	while (n--) {
+		int c = source();
+		if (c < 0)
+			break;
+		ledcontrol_led_sendbyte(c);
+	}
+
+	// Reset status register.
+	SREG = sreg_save;
+#endif
+}
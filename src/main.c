@@ -19,12 +19,19 @@
  */
 
 #include <stdbool.h>
-#include <stdio.h>
 
-#include <util/delay.h>
+#include <avr/interrupt.h>
 
+#include "command.h"
+#include "effect.h"
+#include "framebuffer.h"
 #include "led.h"
+#include "power.h"
+#include "protocol.h"
+#include "scene.h"
+#include "timer.h"
 #include "uart.h"
+#include "zone.h"
 
 
 int
@@ -33,21 +40,27 @@ main(int argc, char **argv)
 	uart_init();
 	uart_init_stdio();
 	ledcontrol_led_init();
+	ledcontrol_zone_init();
+	ledcontrol_protocol_init();
+	ledcontrol_scene_init();
+	timer_init();
+	ledcontrol_power_init();
+	sei();
 
-	rgb color;
 	while (true) {
-		if (!(fscanf(stdin, "%2x%2x%2x", &color.r, &color.g, &color.b) == 3)) {
-			char c;
-			while ((c = getchar()) && (c != '\n') && (c != '\r'))
-				;
+		ledcontrol_protocol_poll();
 
-			continue;
+		// The strip will be updated only once per frame, so the frame rate is
+		// independent from the time needed for parsing commands.
+		uint8_t frames = timer_elapsed();
+		if (frames) {
+			if (ledcontrol_effect_tick(frames))
+				ledcontrol_framebuffer_show();
+			ledcontrol_framebuffer_output();
+			ledcontrol_command_acknowledge();
 		}
 
-		size_t n;
-		for (n = 0; n < 94; n++)
-			ledcontrol_led_write(&color, 1);
-		_delay_us(50);
+		ledcontrol_power_idle();
 	}
 
 	return 0;
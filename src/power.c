@@ -0,0 +1,161 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "power.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <util/delay.h>
+
+#include "timer.h"
+#include "uart.h"
+
+
+/* Optional pin on port D switching the power rail of the strip, e.g. via a
+ * MOSFET. The pin is driven high to power the strip. If all LEDs are black,
+ * the strip will be switched off after writing the black frame. The pin is
+ * usually set by CMake and power gating disabled, if it is not defined.
+ */
+#ifdef LEDCONTROL_POWER_PIN
+#if LEDCONTROL_POWER_PIN < 2 || LEDCONTROL_POWER_PIN > 7
+#error "LEDCONTROL_POWER_PIN must be one of the pins 2 to 7 of port D."
+#elif defined(UART_RTS_PIN) && UART_RTS_PIN == LEDCONTROL_POWER_PIN
+#error "LEDCONTROL_POWER_PIN must not be the same pin as UART_RTS_PIN."
+#endif
+
+/* Time in us the strip needs after power on, before it accepts data. */
+#ifndef LEDCONTROL_POWER_DELAY
+#define LEDCONTROL_POWER_DELAY 1000
+#endif
+#endif
+
+
+/** \brief Init sleep mode and the power gate.
+ *
+ * \details The strip will be powered off initially, as it is dark after power
+ *  on anyway.
+ */
+void
+ledcontrol_power_init()
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+#ifdef LEDCONTROL_POWER_PIN
+	PORTD &= ~_BV(LEDCONTROL_POWER_PIN);
+	DDRD |= _BV(LEDCONTROL_POWER_PIN);
+#endif
+}
+
+
+/** \brief Sleep until there is something to do.
+ *
+ * \details If no bytes have been received and no frame is due, the MCU will be
+ *  put into idle mode until the next interrupt, i.e. the next received byte or
+ *  frame. Interrupts are disabled while checking, so an interrupt can't slip
+ *  in between the check and going to sleep, as the instruction following sei
+ *  is always executed before any interrupt.
+ */
+void
+ledcontrol_power_idle()
+{
+	cli();
+	if (uart_available() == 0 && !timer_pending()) {
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+
+
+#ifdef LEDCONTROL_POWER_PIN
+/** \brief Check whether all bytes of a frame are zero.
+ *
+ *
+ * \param data Pointer to the rendered bytes.
+ * \param n Number of bytes.
+ *
+ * \return True if all LEDs are black, otherwise false.
+ */
+static bool
+ledcontrol_power_black(const uint8_t *data, uint16_t n)
+{
+	while (n--)
+		if (*data++)
+			return false;
+
+	return true;
+}
+#endif
+
+
+/** \brief Power on the strip.
+ *
+ * \details If the strip is powered off, this function waits until the strip is
+ *  ready after switching it on.
+ */
+void
+ledcontrol_power_on()
+{
+#ifdef LEDCONTROL_POWER_PIN
+	if (PORTD & _BV(LEDCONTROL_POWER_PIN))
+		return;
+
+	PORTD |= _BV(LEDCONTROL_POWER_PIN);
+	_delay_us(LEDCONTROL_POWER_DELAY);
+#endif
+}
+
+
+/** \brief Power the strip for the frame about to be written.
+ *
+ * \details The strip will be powered on, unless the frame is black.
+ *
+ *
+ * \param data Pointer to the rendered bytes.
+ * \param n Number of bytes.
+ */
+void
+ledcontrol_power_frame(const uint8_t *data, uint16_t n)
+{
+#ifdef LEDCONTROL_POWER_PIN
+	if (!ledcontrol_power_black(data, n))
+		ledcontrol_power_on();
+#endif
+}
+
+
+/** \brief Power off the strip, if the frame written is black.
+ *
+ *
+ * \param data Pointer to the rendered bytes.
+ * \param n Number of bytes.
+ */
+void
+ledcontrol_power_written(const uint8_t *data, uint16_t n)
+{
+#ifdef LEDCONTROL_POWER_PIN
+	if ((PORTD & _BV(LEDCONTROL_POWER_PIN)) &&
+	    ledcontrol_power_black(data, n))
+		PORTD &= ~_BV(LEDCONTROL_POWER_PIN);
+#endif
+}
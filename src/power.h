@@ -0,0 +1,36 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_POWER_H
+#define LEDCONTROL_POWER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+void ledcontrol_power_init();
+void ledcontrol_power_idle();
+void ledcontrol_power_on();
+void ledcontrol_power_frame(const uint8_t *data, uint16_t n);
+void ledcontrol_power_written(const uint8_t *data, uint16_t n);
+
+
+#endif
@@ -0,0 +1,491 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "protocol.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "command.h"
+#include "config.h"
+#include "framebuffer.h"
+#include "stats.h"
+#include "timer.h"
+#include "uart.h"
+
+
+/* Maximum payload length of a binary frame. Frames with a longer payload will
+ * be discarded.
+ */
+#ifndef LEDCONTROL_PROTOCOL_PAYLOAD_MAX
+#define LEDCONTROL_PROTOCOL_PAYLOAD_MAX 128
+#endif
+
+#if LEDCONTROL_PROTOCOL_PAYLOAD_MAX > 255
+#error "LEDCONTROL_PROTOCOL_PAYLOAD_MAX must not be greater than 255."
+#endif
+
+/* States of the frame parser. */
+enum ledcontrol_protocol_state
+{
+	STATE_TEXT,
+	STATE_ADDRESS,
+	STATE_COMMAND,
+	STATE_LENGTH,
+	STATE_PAYLOAD,
+	STATE_CRC,
+	STATE_SKIP
+};
+
+
+static enum ledcontrol_protocol_state state = STATE_TEXT;
+static uint8_t command;
+static uint8_t length;
+static uint8_t crc;
+static uint8_t pos;
+static uint8_t payload[LEDCONTROL_PROTOCOL_PAYLOAD_MAX];
+
+/* Whether the frame being received is addressed to another device, whether it
+ * is addressed to several devices and whether it may be replied to. Frames
+ * without address are executed by all devices, so they are treated as
+ * broadcast, if this device has an address. Otherwise they are treated as
+ * addressed to this device only, as there is a single device on the link.
+ */
+static bool foreign;
+static bool multicast;
+static bool unicast;
+/* Remaining bytes of a skipped frame including its CRC, or of the raw bytes
+ * following a STREAM to another device.
+ */
+static uint16_t skip;
+
+/* Address of this device and the groups it belongs to (bit n for group n). If
+ * the device has no valid address, it only executes frames without address or
+ * addressed to all devices.
+ */
+static uint8_t address = LEDCONTROL_PROTOCOL_BROADCAST;
+static uint16_t groups = 0;
+
+/* State of the text mode decoder: the number of decoded colors of the current
+ * line, the number of hex digits decoded for the next color, the bytes of this
+ * color in r, g, b (, w) order and whether the line contains invalid data.
+ */
+static uint16_t text_colors;
+static uint8_t text_digits;
+static uint8_t text_color[LEDCONTROL_CHIPSET_CHANNELS];
+static bool text_invalid;
+
+
+/* Number of hex digits of a color in text mode. */
+#define TEXT_COLOR_DIGITS (2 * LEDCONTROL_CHIPSET_CHANNELS)
+
+/* Marker for invalid characters in \ref text_hex. */
+#define TEXT_HEX_INVALID 0xFF
+
+
+/** \brief Values of the characters '0' to 'f' as hex digit.
+ *
+ * \details Characters not being a hex digit are marked as \ref
+ *  TEXT_HEX_INVALID, so a digit can be decoded with a range check and a single
+ *  table lookup.
+ */
+static const uint8_t text_hex['f' - '0' + 1] PROGMEM = {
+    // '0' to '9'
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+    // ':' to '@'
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    // 'A' to 'F'
+    10, 11, 12, 13, 14, 15,
+    // 'G' to '`'
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    TEXT_HEX_INVALID, TEXT_HEX_INVALID,
+    // 'a' to 'f'
+    10, 11, 12, 13, 14, 15};
+
+
+/** \brief Get the color decoded last in text mode.
+ *
+ *
+ * \return The decoded color.
+ */
+static inline rgb
+ledcontrol_protocol_text_color()
+{
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	rgb color = {.r = text_color[0],
+	             .g = text_color[1],
+	             .b = text_color[2],
+	             .w = text_color[3]};
+#else
+	rgb color = {.r = text_color[0], .g = text_color[1], .b = text_color[2]};
+#endif
+	return color;
+}
+
+
+/** \brief Store the decoded color in the back buffer.
+ *
+ * \details The color will be set for the next LED. Colors exceeding the strip
+ *  will be counted, but not stored.
+ */
+static void
+ledcontrol_protocol_text_store()
+{
+	rgb color = ledcontrol_protocol_text_color();
+	ledcontrol_framebuffer_set(text_colors, &color);
+
+	if (text_colors < UINT16_MAX)
+		text_colors++;
+	text_digits = 0;
+}
+
+
+/** \brief Handle the end of a text mode line.
+ *
+ * \details A text mode line contains hex strings in RRGGBB notation
+ *  (RRGGBBWW for chipsets with four channels), one for each LED starting at the
+ *  first one. The colors have already been decoded into the back buffer while
+ *  receiving the line. If the line contains a single color, it will be set for
+ *  all LEDs. For chipsets with four channels, the white channel of a single
+ *  color is optional. Valid lines will be shown immediately. For invalid lines,
+ *  the back buffer will be reverted, so any partially decoded colors will be
+ *  discarded.
+ */
+static void
+ledcontrol_protocol_line()
+{
+	if (text_colors == 0 && text_digits == 0 && !text_invalid)
+		return;
+
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	if (text_colors == 0 && text_digits == 6) {
+		text_color[3] = 0;
+		ledcontrol_protocol_text_store();
+	}
+#endif
+
+	if (text_invalid || text_digits != 0) {
+		ledcontrol_framebuffer_revert();
+		return;
+	}
+
+	if (text_colors == 1) {
+		rgb color = ledcontrol_protocol_text_color();
+		ledcontrol_framebuffer_fill(0, ledcontrol_led_count, &color);
+	}
+	ledcontrol_framebuffer_show();
+}
+
+
+/** \brief Reset the text mode decoder for a new line.
+ */
+static void
+ledcontrol_protocol_text_reset()
+{
+	text_colors = 0;
+	text_digits = 0;
+	text_invalid = false;
+}
+
+
+/** \brief Feed one byte of a text mode line into the decoder.
+ *
+ * \details Hex digits will be decoded as they arrive, so no line buffer is
+ *  needed and the colors are stored in the back buffer right after their last
+ *  digit has been received.
+ *
+ *
+ * \param c The received byte.
+ */
+static void
+ledcontrol_protocol_text(uint8_t c)
+{
+	if (c == '\n' || c == '\r') {
+		ledcontrol_protocol_line();
+		ledcontrol_protocol_text_reset();
+		return;
+	}
+
+	if (text_invalid)
+		return;
+
+	uint8_t digit = TEXT_HEX_INVALID;
+	if (c >= '0' && c <= 'f')
+		digit = pgm_read_byte(&text_hex[c - '0']);
+	if (digit == TEXT_HEX_INVALID) {
+		text_invalid = true;
+		return;
+	}
+
+	uint8_t *p = text_color + (text_digits >> 1);
+	*p = (*p << 4) | digit;
+	if (++text_digits == TEXT_COLOR_DIGITS)
+		ledcontrol_protocol_text_store();
+}
+
+
+/** \brief Check the address of a frame.
+ *
+ *
+ * \param addr Address of the frame.
+ *
+ * \return True if this device needs to execute the frame, otherwise false.
+ */
+static bool
+ledcontrol_protocol_match(uint8_t addr)
+{
+	if (addr == LEDCONTROL_PROTOCOL_BROADCAST)
+		return true;
+	if (addr >= LEDCONTROL_PROTOCOL_GROUP)
+		return groups & (1U << (addr - LEDCONTROL_PROTOCOL_GROUP));
+	return addr == address;
+}
+
+
+/** \brief Apply an address and groups.
+ *
+ *
+ * \param addr The device address.
+ * \param mask The group mask.
+ *
+ * \return True if \p addr is a valid device address, otherwise false.
+ */
+static bool
+ledcontrol_protocol_apply(uint8_t addr, uint16_t mask)
+{
+	if (addr == LEDCONTROL_PROTOCOL_BROADCAST ||
+	    addr > LEDCONTROL_PROTOCOL_DEVICE_MAX)
+		return false;
+
+	address = addr;
+	groups = mask;
+	return true;
+}
+
+
+/** \brief Init the parser with the address stored in EEPROM.
+ *
+ * \details If the EEPROM holds no valid address, the device will not be
+ *  addressable and belongs to no group.
+ */
+void
+ledcontrol_protocol_init()
+{
+	ledcontrol_protocol_apply(eeprom_read_byte(&ledcontrol_eeprom.address),
+	                          eeprom_read_word(&ledcontrol_eeprom.groups));
+}
+
+
+/** \brief Set the device address and groups and store them in EEPROM.
+ *
+ *
+ * \param addr The device address.
+ * \param mask The group mask, bit n for group n.
+ *
+ * \return True if the address is valid and has been applied, otherwise false.
+ */
+bool
+ledcontrol_protocol_configure(uint8_t addr, uint16_t mask)
+{
+	if (!ledcontrol_protocol_apply(addr, mask))
+		return false;
+
+	eeprom_update_byte(&ledcontrol_eeprom.address, addr);
+	eeprom_update_word(&ledcontrol_eeprom.groups, mask);
+
+	return true;
+}
+
+
+/** \brief Check whether the current frame may be replied to.
+ *
+ *
+ * \return True if the frame being executed is addressed to this device only,
+ *  or has no address and this device has no address either, otherwise false.
+ */
+bool
+ledcontrol_protocol_may_reply()
+{
+	return unicast;
+}
+
+
+/** \brief Check whether the current frame is addressed to several devices.
+ *
+ *
+ * \return True if the frame being executed was sent to the broadcast or a
+ *  group address, or has no address and this device has an address, otherwise
+ *  false.
+ */
+bool
+ledcontrol_protocol_multicast()
+{
+	return multicast;
+}
+
+
+/** \brief Feed one byte into the frame parser.
+ *
+ *
+ * \param c The received byte.
+ */
+static void
+ledcontrol_protocol_byte(uint8_t c)
+{
+	switch (state) {
+		case STATE_TEXT:
+			if (c != LEDCONTROL_PROTOCOL_SYNC &&
+			    c != LEDCONTROL_PROTOCOL_SYNC_ADDRESSED) {
+				ledcontrol_protocol_text(c);
+				return;
+			}
+
+			// A binary frame interrupts any pending text mode line, so the
+			// colors already decoded need to be discarded.
+			if (text_colors)
+				ledcontrol_framebuffer_revert();
+			ledcontrol_protocol_text_reset();
+			crc = 0;
+			foreign = false;
+			multicast = (address != LEDCONTROL_PROTOCOL_BROADCAST);
+			unicast = !multicast;
+			state = (c == LEDCONTROL_PROTOCOL_SYNC) ? STATE_COMMAND
+			                                       : STATE_ADDRESS;
+			break;
+
+		case STATE_ADDRESS:
+			foreign = !ledcontrol_protocol_match(c);
+			multicast = (c == LEDCONTROL_PROTOCOL_BROADCAST ||
+			             c >= LEDCONTROL_PROTOCOL_GROUP);
+			unicast = !multicast;
+			crc = _crc8_ccitt_update(crc, c);
+			state = STATE_COMMAND;
+			break;
+
+		case STATE_COMMAND:
+			command = c;
+			crc = _crc8_ccitt_update(crc, c);
+			state = STATE_LENGTH;
+			break;
+
+		case STATE_LENGTH:
+			// Frames for other devices will be skipped without decoding
+			// their payload. STREAM frames need to be decoded, as the raw
+			// bytes following them would be parsed as frames otherwise.
+			if (foreign && command != LEDCONTROL_COMMAND_STREAM) {
+				skip = c + 1;
+				state = STATE_SKIP;
+				break;
+			}
+
+			length = c;
+			pos = 0;
+			crc = _crc8_ccitt_update(crc, c);
+			state = (length > 0) ? STATE_PAYLOAD : STATE_CRC;
+			break;
+
+		case STATE_PAYLOAD:
+			// Payload exceeding the buffer will be counted, but not stored.
+			// The CRC check will fail in this case, so the frame is dropped.
+			if (pos < LEDCONTROL_PROTOCOL_PAYLOAD_MAX)
+				payload[pos] = c;
+			crc = _crc8_ccitt_update(crc, c);
+			if (++pos == length)
+				state = STATE_CRC;
+			break;
+
+		case STATE_CRC:
+			state = STATE_TEXT;
+			if (c != crc || length > LEDCONTROL_PROTOCOL_PAYLOAD_MAX)
+				ledcontrol_stats_crc_error();
+			else if (!foreign)
+				ledcontrol_command_execute(command, payload, length);
+			else if (length == 2) {
+				// Skip the raw bytes of a STREAM to another device.
+				skip = payload[0] | (payload[1] << 8);
+				if (skip > 0)
+					state = STATE_SKIP;
+			}
+			break;
+
+		case STATE_SKIP:
+			if (--skip == 0)
+				state = STATE_TEXT;
+			break;
+	}
+}
+
+
+/** \brief Process all bytes waiting in the UART receive buffer.
+ *
+ * \details Bytes will be read from the receive buffer without blocking, so this
+ *  function may be called in the main loop. Commands will be executed as soon
+ *  as a binary frame or text mode line is complete.
+ */
+void
+ledcontrol_protocol_poll()
+{
+	int c = uart_read();
+	if (c < 0)
+		return;
+
+	uint16_t start = timer_now();
+	do
+		ledcontrol_protocol_byte(c);
+	while ((c = uart_read()) >= 0);
+	ledcontrol_stats_time(LEDCONTROL_STATS_PARSE, start);
+}
+
+
+/** \brief Send a binary frame to the host.
+ *
+ * \details The frame will be queued in the UART transmit buffer, so this
+ *  function doesn't wait for the frame being sent.
+ *
+ *
+ * \param cmd Command identifier.
+ * \param payload Pointer to the payload.
+ * \param len Length of \p payload.
+ */
+void
+ledcontrol_protocol_send(uint8_t cmd, const uint8_t *payload, uint8_t len)
+{
+	uint8_t crc = _crc8_ccitt_update(0, cmd);
+	crc = _crc8_ccitt_update(crc, len);
+
+	uart_write(LEDCONTROL_PROTOCOL_SYNC);
+	uart_write(cmd);
+	uart_write(len);
+	while (len--) {
+		crc = _crc8_ccitt_update(crc, *payload);
+		uart_write(*payload++);
+	}
+	uart_write(crc);
+}
@@ -0,0 +1,74 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_PROTOCOL_H
+#define LEDCONTROL_PROTOCOL_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Binary frames start with this byte, which will never be part of a text mode
+ * line. A frame has the following layout:
+ *
+ *   sync | command | length | payload[length] | crc
+ *
+ * The CRC-8 (polynomial 0x07, initial value 0) covers command, length and the
+ * payload.
+ */
+#define LEDCONTROL_PROTOCOL_SYNC 0xA5
+
+/* Addressed frames start with this byte instead and have an additional address
+ * byte, which is covered by the CRC, too:
+ *
+ *   sync | address | command | length | payload[length] | crc
+ *
+ * Frames addressed to other devices will be skipped by their length without
+ * decoding them. Only STREAM frames will be decoded, so the raw bytes following
+ * them can be skipped, too. Frames without address will be executed by all
+ * devices.
+ */
+#define LEDCONTROL_PROTOCOL_SYNC_ADDRESSED 0xA6
+
+/* Addresses of the bus: the broadcast address, device addresses and the group
+ * addresses LEDCONTROL_PROTOCOL_GROUP + 0 to 15.
+ */
+#define LEDCONTROL_PROTOCOL_BROADCAST 0x00
+#define LEDCONTROL_PROTOCOL_DEVICE_MAX 0xEF
+#define LEDCONTROL_PROTOCOL_GROUP 0xF0
+
+/* Replies of the device use the layout of frames without address. The device
+ * replies only to frames addressed to the device itself, so devices sharing a
+ * bus never reply at the same time. A device without address, i.e. a single
+ * device on its link, replies to frames without address instead.
+ */
+
+
+void ledcontrol_protocol_init();
+bool ledcontrol_protocol_configure(uint8_t address, uint16_t groups);
+bool ledcontrol_protocol_may_reply();
+bool ledcontrol_protocol_multicast();
+void ledcontrol_protocol_poll();
+void ledcontrol_protocol_send(uint8_t cmd, const uint8_t *payload,
+                              uint8_t len);
+
+
+#endif
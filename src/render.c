@@ -0,0 +1,396 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "render.h"
+
+#include <avr/pgmspace.h>
+
+
+#if defined(LEDCONTROL_GAMMA) && defined(LEDCONTROL_DITHER)
+/** \brief Gamma correction table with 16 bit precision.
+ *
+ * \details This table maps linear color values to the LED's PWM values with a
+ *  gamma of 2.8 as 8.8 fixed point values, so the fractional part can be
+ *  dithered. The maximum is 255.0, so adding the residual of dithering will
+ *  never overflow.
+ */
+static const uint16_t gamma_table[256] PROGMEM = {
+	    0,     0,     0,     0,     1,     1,     2,     3,
+	    4,     6,     8,    10,    13,    16,    19,    23,
+	   28,    33,    39,    45,    52,    60,    68,    78,
+	   87,    98,   109,   121,   134,   148,   163,   179,
+	  195,   213,   232,   251,   272,   293,   316,   340,
+	  365,   391,   418,   447,   477,   508,   540,   573,
+	  608,   644,   682,   721,   761,   802,   846,   890,
+	  936,   984,  1033,  1084,  1136,  1190,  1245,  1302,
+	 1361,  1421,  1483,  1547,  1612,  1680,  1749,  1820,
+	 1892,  1967,  2043,  2121,  2202,  2284,  2368,  2454,
+	 2542,  2632,  2724,  2818,  2914,  3012,  3112,  3215,
+	 3319,  3426,  3535,  3646,  3759,  3875,  3992,  4112,
+	 4235,  4359,  4486,  4616,  4748,  4882,  5018,  5157,
+	 5299,  5442,  5589,  5738,  5889,  6043,  6200,  6359,
+	 6520,  6685,  6852,  7021,  7194,  7369,  7546,  7727,
+	 7910,  8096,  8285,  8476,  8671,  8868,  9068,  9271,
+	 9477,  9685,  9897, 10112, 10329, 10550, 10774, 11000,
+	11230, 11463, 11698, 11937, 12179, 12425, 12673, 12924,
+	13179, 13437, 13698, 13962, 14230, 14501, 14775, 15052,
+	15333, 15617, 15905, 16196, 16490, 16788, 17089, 17393,
+	17701, 18013, 18328, 18646, 18968, 19294, 19623, 19956,
+	20292, 20632, 20976, 21323, 21674, 22029, 22387, 22750,
+	23115, 23485, 23859, 24236, 24617, 25002, 25390, 25783,
+	26179, 26580, 26984, 27392, 27804, 28220, 28640, 29064,
+	29492, 29925, 30361, 30801, 31245, 31694, 32146, 32603,
+	33064, 33529, 33998, 34471, 34949, 35431, 35917, 36407,
+	36902, 37400, 37904, 38411, 38923, 39439, 39960, 40485,
+	41015, 41548, 42087, 42630, 43177, 43729, 44285, 44846,
+	45411, 45981, 46556, 47135, 47718, 48307, 48900, 49497,
+	50100, 50707, 51318, 51935, 52556, 53182, 53812, 54448,
+	55088, 55733, 56383, 57038, 57698, 58362, 59032, 59706,
+	60385, 61070, 61759, 62453, 63152, 63856, 64566, 65280
+};
+#elif defined(LEDCONTROL_GAMMA)
+/** \brief Gamma correction table.
+ *
+ * \details This table maps linear color values to the LED's PWM values with a
+ *  gamma of 2.8, so color gradients look linear to the human eye.
+ */
+static const uint8_t gamma_table[256] PROGMEM = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,
+	  1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+	  2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,
+	  4,   5,   5,   5,   5,   6,   6,   6,   6,   7,   7,   7,
+	  7,   8,   8,   8,   9,   9,   9,  10,  10,  10,  11,  11,
+	 11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+	 17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,
+	 23,  24,  24,  25,  25,  26,  27,  27,  28,  29,  29,  30,
+	 31,  32,  32,  33,  34,  35,  35,  36,  37,  38,  39,  39,
+	 40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+	 51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+	 64,  66,  67,  68,  69,  70,  72,  73,  74,  75,  77,  78,
+	 79,  81,  82,  83,  85,  86,  87,  89,  90,  92,  93,  95,
+	 96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+	115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135,
+	137, 138, 140, 142, 144, 146, 148, 150, 152, 154, 156, 158,
+	160, 162, 164, 167, 169, 171, 173, 175, 177, 180, 182, 184,
+	186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+	215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244,
+	247, 249, 252, 255};
+#endif
+
+
+/* Global brightness of the strip. A value of 255 means full brightness. */
+static uint8_t brightness = 255;
+
+/* White balance, i.e. a factor for each channel. A value of 255 leaves the
+ * channel unmodified.
+ */
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+static rgb balance = {.r = 255, .g = 255, .b = 255, .w = 255};
+#else
+static rgb balance = {.r = 255, .g = 255, .b = 255};
+#endif
+
+/* Factors for each channel in wire order, combining brightness and white
+ * balance. These are calculated once when either of them changes, so rendering
+ * needs a single multiplication per channel, regardless of the features used.
+ */
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+static uint16_t scale[LEDCONTROL_CHIPSET_CHANNELS] = {256, 256, 256, 256};
+#else
+static uint16_t scale[LEDCONTROL_CHIPSET_CHANNELS] = {256, 256, 256};
+#endif
+
+
+#ifdef LEDCONTROL_DITHER
+/** \brief Residuals of temporal dithering.
+ *
+ * \details Colors are calculated with 8.8 fixed point precision. The fraction
+ *  not sent to the strip will be kept for each channel and added to the next
+ *  frame (error diffusion over time), so the strip shows the exact color on
+ *  average. This needs one additional byte per channel only, instead of a full
+ *  16 bit framebuffer.
+ */
+static uint8_t residuals[LEDCONTROL_LED_MAX * LEDCONTROL_CHIPSET_CHANNELS];
+
+/* Residual of the next channel to be rendered. */
+static uint8_t *residual;
+
+/* Whether the frame being rendered has any non-zero residual. */
+static bool dithering;
+#endif
+
+
+/** \brief Calculate the factor of a channel.
+ *
+ *
+ * \param value The white balance of the channel.
+ *
+ * \return The product of brightness and \p value, where 256 means unmodified.
+ */
+static inline uint16_t
+ledcontrol_render_scale(uint8_t value)
+{
+	return (((brightness + 1) * (value + 1)) >> 8);
+}
+
+
+/** \brief Recalculate the factors of all channels in wire order.
+ */
+static void
+ledcontrol_render_update()
+{
+	scale[0] = ledcontrol_render_scale(balance.LEDCONTROL_CHIPSET_C0);
+	scale[1] = ledcontrol_render_scale(balance.LEDCONTROL_CHIPSET_C1);
+	scale[2] = ledcontrol_render_scale(balance.LEDCONTROL_CHIPSET_C2);
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+	scale[3] = ledcontrol_render_scale(balance.LEDCONTROL_CHIPSET_C3);
+#endif
+}
+
+
+/** \brief Set the global brightness of the strip.
+ *
+ * \details The brightness will be applied by \ref ledcontrol_render, so the
+ *  framebuffer needs to be rendered again for the new brightness to become
+ *  visible.
+ *
+ *
+ * \param value The new brightness. A value of 255 means full brightness.
+ */
+void
+ledcontrol_render_set_brightness(uint8_t value)
+{
+	brightness = value;
+	ledcontrol_render_update();
+}
+
+
+/** \brief Get the global brightness of the strip.
+ *
+ *
+ * \return The brightness set by \ref ledcontrol_render_set_brightness.
+ */
+uint8_t
+ledcontrol_render_get_brightness()
+{
+	return brightness;
+}
+
+
+/** \brief Set the white balance of the strip.
+ *
+ * \details Like the brightness, the white balance will be applied by \ref
+ *  ledcontrol_render, so the framebuffer needs to be rendered again.
+ *
+ *
+ * \param value Factor for each channel. A value of 255 leaves the channel
+ *  unmodified.
+ */
+void
+ledcontrol_render_set_balance(const rgb *value)
+{
+	balance = *value;
+	ledcontrol_render_update();
+}
+
+
+/** \brief Apply gamma correction and brightness to a single channel.
+ *
+ * \details With dithering enabled, channels need to be rendered in the order of
+ *  the framebuffer, as the residuals are consumed sequentially.
+ *
+ *
+ * \param value The linear channel value.
+ * \param scale The factor of the channel, where 256 means unmodified.
+ *
+ * \return The channel value to be sent to the strip.
+ */
+static inline uint8_t
+ledcontrol_render_channel(uint8_t value, uint16_t scale)
+{
+#ifdef LEDCONTROL_DITHER
+#ifdef LEDCONTROL_GAMMA
+	uint16_t v = ((uint32_t)pgm_read_word(&gamma_table[value]) * scale) >> 8;
+#else
+	uint16_t v = value * scale;
+#endif
+	// The frame needs to be rendered again as long as the channel has a
+	// fractional part, even if its residual just wrapped to zero.
+	if (v & 0xFF)
+		dithering = true;
+
+	v += *residual;
+	*residual++ = v & 0xFF;
+
+	return v >> 8;
+#else
+#ifdef LEDCONTROL_GAMMA
+	value = pgm_read_byte(&gamma_table[value]);
+#endif
+	return (value * scale) >> 8;
+#endif
+}
+
+
+/** \brief Start rendering a new frame.
+ */
+static inline void
+ledcontrol_render_begin()
+{
+#ifdef LEDCONTROL_DITHER
+	residual = residuals;
+	dithering = false;
+#endif
+}
+
+
+/** \brief Finish rendering a frame.
+ *
+ *
+ * \return True if the frame needs to be rendered again for dithering, even if
+ *  the colors don't change.
+ */
+static inline bool
+ledcontrol_render_end()
+{
+#ifdef LEDCONTROL_DITHER
+	return dithering;
+#else
+	return false;
+#endif
+}
+
+
+/** \brief Render \p n colors for output to the strip.
+ *
+ * \details This function applies gamma correction, the global brightness and
+ *  the white balance to all colors once per frame and stores them in the
+ *  chipset's order of the color channels. The timing critical code in \ref
+ *  ledcontrol_led_write then just needs to send the bytes unmodified.
+ *
+ *
+ * \param dst Pointer to the rendered bytes, \ref LEDCONTROL_CHIPSET_CHANNELS
+ *  for each color.
+ * \param src Pointer to the colors of the framebuffer.
+ * \param n Number of colors to render.
+ *
+ * \return True if the frame needs to be rendered again for temporal dithering,
+ *  otherwise false.
+ */
+bool
+ledcontrol_render(uint8_t *dst, const rgb *src, uint16_t n)
+{
+	ledcontrol_render_begin();
+
+	while (n--) {
+		*dst++ = ledcontrol_render_channel(src->LEDCONTROL_CHIPSET_C0, scale[0]);
+		*dst++ = ledcontrol_render_channel(src->LEDCONTROL_CHIPSET_C1, scale[1]);
+		*dst++ = ledcontrol_render_channel(src->LEDCONTROL_CHIPSET_C2, scale[2]);
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+		*dst++ = ledcontrol_render_channel(src->LEDCONTROL_CHIPSET_C3, scale[3]);
+#endif
+		src++;
+	}
+
+	return ledcontrol_render_end();
+}
+
+
+/** \brief Linear interpolation between two channel values.
+ *
+ *
+ * \param a The start value.
+ * \param b The target value.
+ * \param t Position between \p a (0) and \p b (256) as 0.8 fixed point value.
+ *
+ * \return The interpolated value.
+ */
+static inline uint8_t
+ledcontrol_render_lerp(uint8_t a, uint8_t b, uint8_t t)
+{
+	return a + (((int16_t)(b - a) * t) >> 8);
+}
+
+
+/* Render channel \p c of the blend between \p a and \p b. */
+#define ledcontrol_render_blend_channel(c, i)                                  \
+	ledcontrol_render_channel(ledcontrol_render_lerp(a->c, b->c, t), scale[i])
+
+
+/** \brief Render a blend of \p n colors of \p a and \p b.
+ *
+ * \details This function works like \ref ledcontrol_render, but interpolates
+ *  linearly between the colors of \p a and \p b before applying gamma
+ *  correction, brightness and white balance. This needs a single
+ *  multiplication per channel, so crossfades can be rendered in each frame.
+ *
+ *
+ * \param dst Pointer to the rendered bytes.
+ * \param a Pointer to the start colors.
+ * \param b Pointer to the target colors.
+ * \param t Position between \p a (0) and \p b (256) as 0.8 fixed point value.
+ * \param n Number of colors to render.
+ *
+ * \return True if the frame needs to be rendered again for temporal dithering,
+ *  otherwise false.
+ */
+bool
+ledcontrol_render_blend(uint8_t *dst, const rgb *a, const rgb *b, uint8_t t,
+                        uint16_t n)
+{
+	ledcontrol_render_begin();
+
+	while (n--) {
+		*dst++ = ledcontrol_render_blend_channel(LEDCONTROL_CHIPSET_C0, 0);
+		*dst++ = ledcontrol_render_blend_channel(LEDCONTROL_CHIPSET_C1, 1);
+		*dst++ = ledcontrol_render_blend_channel(LEDCONTROL_CHIPSET_C2, 2);
+#if LEDCONTROL_CHIPSET_CHANNELS == 4
+		*dst++ = ledcontrol_render_blend_channel(LEDCONTROL_CHIPSET_C3, 3);
+#endif
+		a++;
+		b++;
+	}
+
+	return ledcontrol_render_end();
+}
+
+
+/** \brief Dim \p n rendered bytes by \p level.
+ *
+ * \details This function may be used to reduce the brightness of parts of the
+ *  strip after rendering.
+ *
+ *
+ * \param dst Pointer to the rendered bytes.
+ * \param n Number of bytes to dim.
+ * \param level The brightness, where 255 means full brightness.
+ */
+void
+ledcontrol_render_dim(uint8_t *dst, uint16_t n, uint8_t level)
+{
+	const uint16_t scale = level + 1;
+
+	while (n--) {
+		*dst = (*dst * scale) >> 8;
+		dst++;
+	}
+}
@@ -0,0 +1,40 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_RENDER_H
+#define LEDCONTROL_RENDER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led.h"
+
+
+void ledcontrol_render_set_brightness(uint8_t brightness);
+uint8_t ledcontrol_render_get_brightness();
+void ledcontrol_render_set_balance(const rgb *balance);
+bool ledcontrol_render(uint8_t *dst, const rgb *src, uint16_t n);
+bool ledcontrol_render_blend(uint8_t *dst, const rgb *a, const rgb *b,
+                             uint8_t t, uint16_t n);
+void ledcontrol_render_dim(uint8_t *dst, uint16_t n, uint8_t level);
+
+
+#endif
@@ -0,0 +1,147 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "scene.h"
+
+#include <avr/eeprom.h>
+
+#include "config.h"
+#include "effect.h"
+#include "framebuffer.h"
+#include "render.h"
+#include "zone.h"
+
+
+/** \brief Recall the default scene.
+ *
+ * \details If a default scene has been set, it will be shown with the first
+ *  frame, so the strip doesn't stay dark until the host sends a frame.
+ */
+void
+ledcontrol_scene_init()
+{
+	ledcontrol_scene_recall(eeprom_read_byte(&ledcontrol_eeprom.default_scene),
+	                        0);
+}
+
+
+/** \brief Store the current state as scene \p id in EEPROM.
+ *
+ * \details The frame currently shown, the global brightness and the running
+ *  effect will be stored. Writing the EEPROM takes up to a few milliseconds
+ *  per changed byte, so the host should wait for the device before sending
+ *  more data, e.g. by querying its credits.
+ *
+ *
+ * \param id ID of the scene.
+ *
+ * \return True if the scene has been stored, otherwise false.
+ */
+bool
+ledcontrol_scene_save(uint8_t id)
+{
+	if (id >= LEDCONTROL_SCENE_MAX)
+		return false;
+	ledcontrol_scene *scene = &ledcontrol_eeprom.scenes[id];
+
+	// Invalidate the scene first, so an interrupted write can't leave a
+	// partially stored scene.
+	eeprom_update_byte(&scene->valid, 0);
+
+	eeprom_update_block(ledcontrol_framebuffer_front(), scene->colors,
+	                    sizeof(scene->colors));
+	eeprom_update_byte(&scene->brightness, ledcontrol_render_get_brightness());
+
+	uint8_t effect[LEDCONTROL_SCENE_EFFECT_SIZE];
+	eeprom_update_byte(&scene->effect_zone, ledcontrol_effect_get(effect));
+	eeprom_update_block(effect, scene->effect, sizeof(effect));
+
+	eeprom_update_byte(&scene->valid, LEDCONTROL_SCENE_VALID);
+
+	return true;
+}
+
+
+/** \brief Recall scene \p id from EEPROM.
+ *
+ * \details The stored frame will be loaded into the back buffer and shown or
+ *  crossfaded to, the stored brightness applied and the stored effect started
+ *  again.
+ *
+ *
+ * \param id ID of the scene.
+ * \param frames Duration of a crossfade in frames, or zero to show the scene
+ *  with the next frame.
+ *
+ * \return True if the scene has been recalled, false if it has not been
+ *  stored.
+ */
+bool
+ledcontrol_scene_recall(uint8_t id, uint16_t frames)
+{
+	if (id >= LEDCONTROL_SCENE_MAX)
+		return false;
+	ledcontrol_scene *scene = &ledcontrol_eeprom.scenes[id];
+	if (eeprom_read_byte(&scene->valid) != LEDCONTROL_SCENE_VALID)
+		return false;
+
+	// Scenes always cover the whole strip.
+	ledcontrol_zone_select(LEDCONTROL_ZONE_ALL);
+
+	uint16_t i;
+	for (i = 0; i < LEDCONTROL_LED_MAX; i++) {
+		rgb color;
+		eeprom_read_block(&color, &scene->colors[i], sizeof(color));
+		ledcontrol_framebuffer_set(i, &color);
+	}
+
+	ledcontrol_render_set_brightness(eeprom_read_byte(&scene->brightness));
+	ledcontrol_framebuffer_refresh();
+
+	uint8_t effect[LEDCONTROL_SCENE_EFFECT_SIZE];
+	eeprom_read_block(effect, scene->effect, sizeof(effect));
+	if (ledcontrol_zone_select(eeprom_read_byte(&scene->effect_zone))) {
+		ledcontrol_effect_set(effect, sizeof(effect));
+		ledcontrol_zone_select(LEDCONTROL_ZONE_ALL);
+	}
+
+	ledcontrol_framebuffer_crossfade(frames);
+
+	return true;
+}
+
+
+/** \brief Set the scene recalled at power on.
+ *
+ *
+ * \param id ID of the scene or \ref LEDCONTROL_SCENE_NONE.
+ *
+ * \return True if the default scene has been set, otherwise false.
+ */
+bool
+ledcontrol_scene_set_default(uint8_t id)
+{
+	if (id >= LEDCONTROL_SCENE_MAX && id != LEDCONTROL_SCENE_NONE)
+		return false;
+
+	eeprom_update_byte(&ledcontrol_eeprom.default_scene, id);
+
+	return true;
+}
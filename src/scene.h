@@ -0,0 +1,70 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_SCENE_H
+#define LEDCONTROL_SCENE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led.h"
+
+
+/* Number of scenes stored in EEPROM. Each scene needs a full framebuffer, so
+ * this is limited by the size of the EEPROM.
+ */
+#ifndef LEDCONTROL_SCENE_MAX
+#define LEDCONTROL_SCENE_MAX 2
+#endif
+
+/* Scene ID for no default scene. */
+#define LEDCONTROL_SCENE_NONE 0xFF
+
+/* Marker of stored scenes. Erased EEPROM cells read as 0xFF. */
+#define LEDCONTROL_SCENE_VALID 0x5C
+
+/* Size of the effect parameters (see ledcontrol_effect_set). */
+#define LEDCONTROL_SCENE_EFFECT_SIZE (3 + LEDCONTROL_CHIPSET_CHANNELS)
+
+
+/** \brief Layout of a scene in EEPROM.
+ */
+typedef struct ledcontrol_scene
+{
+	/* LEDCONTROL_SCENE_VALID, if the scene has been stored. */
+	uint8_t valid;
+	/* Global brightness. */
+	uint8_t brightness;
+	/* Zone and parameters of the effect. */
+	uint8_t effect_zone;
+	uint8_t effect[LEDCONTROL_SCENE_EFFECT_SIZE];
+	/* Colors of all LEDs. */
+	rgb colors[LEDCONTROL_LED_MAX];
+} ledcontrol_scene;
+
+
+void ledcontrol_scene_init();
+bool ledcontrol_scene_save(uint8_t id);
+bool ledcontrol_scene_recall(uint8_t id, uint16_t frames);
+bool ledcontrol_scene_set_default(uint8_t id);
+
+
+#endif
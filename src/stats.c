@@ -0,0 +1,120 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "stats.h"
+
+#include "command.h"
+#include "protocol.h"
+#include "timer.h"
+#include "uart.h"
+
+
+/* Run time of the last and the longest run of each section in timer counts. */
+static uint16_t time_last[LEDCONTROL_STATS_SECTIONS];
+static uint16_t time_max[LEDCONTROL_STATS_SECTIONS];
+
+/* Number of frames with an invalid checksum. */
+static uint16_t crc_errors;
+
+/* Number of frames sent to the strip. */
+static uint16_t frames;
+
+
+/** \brief Record the run time of \p section.
+ *
+ * \details This function should be called at the end of the section with the
+ *  timestamp taken by \ref timer_now at its start.
+ *
+ *
+ * \param section The measured section.
+ * \param start Timestamp of the section's start.
+ */
+void
+ledcontrol_stats_time(enum ledcontrol_stats_section section, uint16_t start)
+{
+	uint16_t time = timer_now() - start;
+
+	time_last[section] = time;
+	if (time > time_max[section])
+		time_max[section] = time;
+}
+
+
+/** \brief Count a frame with an invalid checksum.
+ */
+void
+ledcontrol_stats_crc_error()
+{
+	crc_errors++;
+}
+
+
+/** \brief Count a frame sent to the strip.
+ */
+void
+ledcontrol_stats_frame()
+{
+	frames++;
+}
+
+
+/** \brief Append a 16 bit value to \p p in little endian byte order.
+ *
+ *
+ * \param p Pointer to the reply buffer.
+ * \param value The value to be stored.
+ *
+ * \return Pointer to the byte following the stored value.
+ */
+static uint8_t *
+ledcontrol_stats_u16(uint8_t *p, uint16_t value)
+{
+	*p++ = value & 0xFF;
+	*p++ = value >> 8;
+
+	return p;
+}
+
+
+/** \brief Send all statistics to the host.
+ *
+ * \details The statistics will be sent as STATS frame with 16 bit values, see
+ *  \ref LEDCONTROL_COMMAND_STATS for the layout.
+ */
+void
+ledcontrol_stats_report()
+{
+	uint8_t reply[2 * (5 + 2 * LEDCONTROL_STATS_SECTIONS)];
+	uint8_t *p = reply;
+
+	p = ledcontrol_stats_u16(p, frames);
+	p = ledcontrol_stats_u16(p, timer_missed());
+	p = ledcontrol_stats_u16(p, crc_errors);
+	p = ledcontrol_stats_u16(p, uart_overruns(false));
+	p = ledcontrol_stats_u16(p, uart_overruns(true));
+
+	uint8_t i;
+	for (i = 0; i < LEDCONTROL_STATS_SECTIONS; i++) {
+		p = ledcontrol_stats_u16(p, time_last[i]);
+		p = ledcontrol_stats_u16(p, time_max[i]);
+	}
+
+	ledcontrol_protocol_send(LEDCONTROL_COMMAND_STATS, reply, sizeof(reply));
+}
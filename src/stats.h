@@ -0,0 +1,51 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_STATS_H
+#define LEDCONTROL_STATS_H
+
+
+#include <stdint.h>
+
+
+/* Sections of the main loop, whose run time will be measured. */
+enum ledcontrol_stats_section
+{
+	/* Parsing received bytes and executing commands. */
+	LEDCONTROL_STATS_PARSE,
+
+	/* Rendering the front buffer in the pre-pass. */
+	LEDCONTROL_STATS_RENDER,
+
+	/* Writing the strip, i.e. interrupts are disabled. */
+	LEDCONTROL_STATS_WRITE,
+
+	LEDCONTROL_STATS_SECTIONS
+};
+
+
+void ledcontrol_stats_time(enum ledcontrol_stats_section section,
+                           uint16_t start);
+void ledcontrol_stats_crc_error();
+void ledcontrol_stats_frame();
+void ledcontrol_stats_report();
+
+
+#endif
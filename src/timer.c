@@ -0,0 +1,202 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "timer.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+
+// Timer counts per frame for a given frame rate. As the compare match interrupt
+// compares the next deadline with the counter by their signed difference, the
+// period must be less than half of the counter's range, e.g. at 16 MHz frame
+// rates need to be at least 8 Hz.
+#define TIMER_PERIOD(rate) (F_CPU / TIMER_PRESCALER / (rate))
+#define TIMER_PERIOD_MAX 0x7FFF
+
+#if TIMER_PERIOD(LEDCONTROL_FRAME_RATE) > TIMER_PERIOD_MAX
+#error "Timer: LEDCONTROL_FRAME_RATE is too low for the current F_CPU."
+#elif LEDCONTROL_FRAME_RATE > 255
+#error "Timer: LEDCONTROL_FRAME_RATE must not be greater than 255."
+#endif
+
+
+/* Timer counts per frame. */
+static volatile uint16_t period = TIMER_PERIOD(LEDCONTROL_FRAME_RATE);
+
+/* Number of frames due since the last call of timer_elapsed. */
+static volatile uint8_t frames;
+
+/* Number of frames, that have not been handled before the next frame was due.
+ */
+static uint16_t missed;
+
+
+/** \brief Init timer registers.
+ *
+ * \details This function sets up Timer 1 to run freely, so \ref timer_now may
+ *  be used for timestamps. The compare match A interrupt will be moved ahead
+ *  by one frame period each time it fires, marking a new frame as due.
+ *  Interrupts must be enabled globally after initialization.
+ */
+void
+timer_init()
+{
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11) | _BV(CS10);
+	OCR1A = period;
+	TIMSK1 = _BV(OCIE1A);
+}
+
+
+/** \brief Set the frame rate.
+ *
+ *
+ * \param rate The new frame rate in Hz.
+ *
+ * \return True if the frame rate has been changed, or false if \p rate can't
+ *  be used with the current F_CPU.
+ */
+bool
+timer_set_rate(uint8_t rate)
+{
+	if (rate == 0 || TIMER_PERIOD(rate) > TIMER_PERIOD_MAX)
+		return false;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		period = TIMER_PERIOD(rate);
+	}
+
+	return true;
+}
+
+
+/** \brief Timer 1 compare match A interrupt.
+ *
+ * \details Mark a new frame as due and schedule the next one. If the
+ *  interrupt has been delayed by more than a period, e.g. while interrupts
+ *  were disabled for writing the strip, the compare value would fall behind
+ *  the counter and the next interrupt fire after the counter wrapped. Instead,
+ *  all deadlines passed in the meantime will be skipped and marked as due, so
+ *  they are counted as missed by \ref timer_elapsed. The counter saturates, if
+ *  the main loop doesn't handle the frames in time.
+ */
+ISR(TIMER1_COMPA_vect)
+{
+	uint16_t next = OCR1A;
+	do {
+		next += period;
+
+		if (frames < 0xFF)
+			frames++;
+	} while ((int16_t)(next - TCNT1) <= 0);
+
+	OCR1A = next;
+}
+
+
+/** \brief Get the number of frames due since the last call of this function.
+ *
+ * \details If more than one frame is due, the main loop missed the deadline of
+ *  all but the last one. These frames will be counted as missed.
+ *
+ *
+ * \return The number of frames due.
+ */
+uint8_t
+timer_elapsed()
+{
+	uint8_t ret;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ret = frames;
+		frames = 0;
+	}
+
+	if (ret > 1)
+		missed += ret - 1;
+
+	return ret;
+}
+
+
+/** \brief Check whether a frame is due.
+ *
+ *
+ * \return True if \ref timer_elapsed would return at least one frame.
+ */
+bool
+timer_pending()
+{
+	return frames != 0;
+}
+
+
+/** \brief Get the number of missed frame deadlines.
+ *
+ *
+ * \return The number of missed frames since initialization.
+ */
+uint16_t
+timer_missed()
+{
+	return missed;
+}
+
+
+/** \brief Get the current timestamp.
+ *
+ *
+ * \return The current value of the free running timer. See \ref TIMER_COUNTS
+ *  for converting times into timer counts.
+ */
+uint16_t
+timer_now()
+{
+	uint16_t ret;
+
+	// The 16 bit register needs to be read atomically, as the interrupt
+	// handler accesses 16 bit registers of Timer 1, too.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ret = TCNT1;
+	}
+
+	return ret;
+}
+
+
+/** \brief Wait until \p counts have passed since \p since.
+ *
+ * \details If the time has already passed, this function returns immediately.
+ *  The waiting time must be less than the timer's period of 65536 counts.
+ *
+ *
+ * \param since Timestamp to start from.
+ * \param counts Timer counts to wait.
+ */
+void
+timer_wait(uint16_t since, uint16_t counts)
+{
+	while ((uint16_t)(timer_now() - since) < counts)
+		;
+}
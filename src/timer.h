@@ -0,0 +1,51 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_TIMER_H
+#define LEDCONTROL_TIMER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Default frame rate in Hz. This is usually set by CMake. */
+#ifndef LEDCONTROL_FRAME_RATE
+#define LEDCONTROL_FRAME_RATE 60
+#endif
+
+/* Timer 1 runs freely with a prescaler of 64, i.e. 4 us per count at 16 MHz.
+ * TIMER_COUNTS converts a time in us into timer counts, rounding up.
+ */
+#define TIMER_PRESCALER 64
+#define TIMER_COUNTS(us)                                                       \
+	((((uint32_t)(us)) * (F_CPU / TIMER_PRESCALER / 1000) + 999) / 1000)
+
+
+void timer_init();
+bool timer_set_rate(uint8_t rate);
+uint8_t timer_elapsed();
+bool timer_pending();
+uint16_t timer_missed();
+uint16_t timer_now();
+void timer_wait(uint16_t since, uint16_t counts);
+
+
+#endif
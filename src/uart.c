@@ -26,17 +26,182 @@
 
 #include <stdio.h>
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 
 
-#define BAUD 9600
-#define UBRR F_CPU / 16 / BAUD - 1
+#if BAUD > F_CPU / 8
+#error "UART: The baud rate is too high for the current F_CPU."
+#endif
+
+// Calculate the rounded baud rate registers for normal and double speed mode
+// and the baud rates achieved by them.
+#define UBRR_1X ((F_CPU + 8UL * BAUD) / (16UL * BAUD) - 1)
+#define UBRR_2X ((F_CPU + 4UL * BAUD) / (8UL * BAUD) - 1)
+#define BAUD_1X (F_CPU / (16UL * (UBRR_1X + 1)))
+#define BAUD_2X (F_CPU / (8UL * (UBRR_2X + 1)))
+#define BAUD_ERROR(b) (((b) > BAUD) ? ((b)-BAUD) : (BAUD - (b)))
+
+// Double speed mode will only be used, if it gives a lower error, as the
+// receiver is less tolerant to clock deviations in this mode.
+#if UBRR_2X <= 4095 && BAUD_ERROR(BAUD_2X) < BAUD_ERROR(BAUD_1X)
+#define USE_2X 1
+#define UBRR UBRR_2X
+#define BAUD_REAL BAUD_2X
+#else
+#define USE_2X 0
+#define UBRR UBRR_1X
+#define BAUD_REAL BAUD_1X
+#endif
+
+#if UBRR > 4095
+#error "UART: The baud rate is too low for the current F_CPU."
+#endif
+
+// The baud rate error must not exceed 2%, or the connection will be not
+// reliable. Did you set BAUD and F_CPU correctly?
+#if BAUD_ERROR(BAUD_REAL) * 100 > 2 * BAUD
+#error "UART: The baud rate error is more than 2% with the current F_CPU."
+#endif
+
+
+/* Size of the receive ring buffer. It must be a power of two, so the buffer
+ * indices may simply be masked instead of using expensive modulo operations.
+ * As the indices are free running bytes, a full buffer of 256 bytes couldn't
+ * be distinguished from an empty one, so the size is limited to 128 bytes.
+ */
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 64
+#endif
+
+#if (UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) != 0
+#error "UART_RX_BUFFER_SIZE must be a power of two."
+#elif UART_RX_BUFFER_SIZE > 128
+#error "UART_RX_BUFFER_SIZE must not be greater than 128."
+#endif
+
+#define UART_RX_BUFFER_MASK (UART_RX_BUFFER_SIZE - 1)
+
+/* Size of the transmit ring buffer. The same constraints as for the receive
+ * buffer apply.
+ */
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 32
+#endif
+
+#if (UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) != 0
+#error "UART_TX_BUFFER_SIZE must be a power of two."
+#elif UART_TX_BUFFER_SIZE > 128
+#error "UART_TX_BUFFER_SIZE must not be greater than 128."
+#endif
+
+#define UART_TX_BUFFER_MASK (UART_TX_BUFFER_SIZE - 1)
+
+/* Policy for a full transmit buffer: if UART_TX_DROP is defined to a non-zero
+ * value, bytes that don't fit into the buffer will be dropped, so sending never
+ * stalls the main loop. Otherwise uart_write blocks until there is space.
+ */
+#ifndef UART_TX_DROP
+#define UART_TX_DROP 0
+#endif
+
+/* Optional RTS line on port D for hardware flow control. It is driven low, if
+ * the host may send, and high, if the receive buffer is filled above the
+ * threshold or the UART can't receive, as interrupts need to be disabled. The
+ * pin is usually set by CMake and the feature disabled, if it is not defined.
+ */
+#ifdef UART_RTS_PIN
+#if UART_RTS_PIN < 2 || UART_RTS_PIN > 7
+#error "UART_RTS_PIN must be one of the pins 2 to 7 of port D."
+#endif
+
+#ifndef UART_RTS_THRESHOLD
+#define UART_RTS_THRESHOLD (UART_RX_BUFFER_SIZE * 3 / 4)
+#endif
+#endif
+
+/* Iterations of the polling loop in uart_poll for a timeout of about 1 ms. */
+#define UART_POLL_TIMEOUT (F_CPU / 8000)
+
+
+/** \brief Receive ring buffer.
+ *
+ * \details The buffer is a single-producer / single-consumer queue: only the
+ *  USART_RX interrupt writes \ref uart_rx_head and only the main loop writes
+ *  \ref uart_rx_tail. As both indices are single bytes, they can be accessed
+ *  atomically without disabling interrupts. The indices run freely and are
+ *  masked on access, so a full buffer can be distinguished from an empty one.
+ */
+static uint8_t uart_rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t uart_rx_head;
+static volatile uint8_t uart_rx_tail;
+
+/** \brief Transmit ring buffer.
+ *
+ * \details Same as the receive buffer, but the main loop writes \ref
+ *  uart_tx_head and the USART_UDRE interrupt writes \ref uart_tx_tail.
+ */
+static uint8_t uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t uart_tx_head;
+static volatile uint8_t uart_tx_tail;
+
+#ifdef UART_RTS_PIN
+/* Whether the host has been told to pause via \ref uart_pause. */
+static volatile bool uart_rts_paused;
+#endif
+
+/* Number of bytes dropped, because the ring buffer was full (software) or the
+ * USART hardware buffer overflowed before the interrupt could read it.
+ */
+static volatile uint16_t uart_rx_overruns_sw;
+static volatile uint16_t uart_rx_overruns_hw;
+
+
+/** \brief Update the RTS line.
+ *
+ * \details The line will be set, if the host should stop sending. Interrupts
+ *  need to be disabled, as the receive interrupt may change the buffer and the
+ *  line between checking the buffer and setting the pin. The main loop needs to
+ *  call \ref uart_rts_sync instead. Without an RTS pin, this function does
+ *  nothing.
+ */
+static inline void
+uart_rts_update()
+{
+#ifdef UART_RTS_PIN
+	if (uart_rts_paused ||
+	    (uint8_t)(uart_rx_head - uart_rx_tail) >= UART_RTS_THRESHOLD)
+		PORTD |= _BV(UART_RTS_PIN);
+	else
+		PORTD &= ~_BV(UART_RTS_PIN);
+#endif
+}
+
+
+/** \brief Update the RTS line from the main loop.
+ *
+ * \details Interrupts will be disabled while updating the line (see \ref
+ *  uart_rts_update).
+ */
+static inline void
+uart_rts_sync()
+{
+#ifdef UART_RTS_PIN
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uart_rts_update();
+	}
+#endif
+}
 
 
 /** \brief Init USART registers.
  *
  * \details This function sets all necessary register bits for the USART
- *  connection for 8n1 transmission with 9600 BAUD.
+ *  connection for 8n1 transmission with \ref BAUD baud. Received bytes will be
+ *  stored in the receive buffer by an interrupt, so interrupts must be enabled
+ *  globally after initialization.
  */
 void
 uart_init()
@@ -44,12 +209,23 @@ uart_init()
 	// set USART baud rate
 	UBRR0H = (unsigned char)((UBRR) >> 8);
 	UBRR0L = (unsigned char)(UBRR);
+#if USE_2X
+	UCSR0A |= _BV(U2X0);
+#else
+	UCSR0A &= ~_BV(U2X0);
+#endif
 
-	// enable receiver and transmitter
-	UCSR0B = _BV(RXEN0) | _BV(TXEN0);
+	// enable receiver, transmitter and receive complete interrupt
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
 
 	// set frame format: 8n1
 	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+
+#ifdef UART_RTS_PIN
+	// The host may send right away.
+	PORTD &= ~_BV(UART_RTS_PIN);
+	DDRD |= _BV(UART_RTS_PIN);
+#endif
 }
 
 
@@ -84,20 +260,109 @@ uart_init_stdio()
  * \param c Char to be send.
  * \param stream Pointer to sending stream.
  *
- * \return This function returns 0 after sucessful reading one byte.
+ * \return This function returns 0 after sucessful queuing one byte or EOF, if
+ *  the byte has been dropped.
  */
 int
 uart_putchar(char c, FILE *stream)
+{
+	return uart_write(c) ? 0 : EOF;
+}
+
+
+/** \brief Send the next byte of the transmit buffer by polling.
+ *
+ * \details If interrupts are disabled, the USART_UDRE interrupt can't drain
+ *  the transmit buffer. This function does its job instead by waiting for the
+ *  data register to get empty.
+ */
+static void
+uart_tx_poll()
 {
 	while (!(UCSR0A & _BV(UDRE0)))
 		;
-	UDR0 = c;
 
-	return 0;
+	uint8_t tail = uart_tx_tail;
+	UDR0 = uart_tx_buffer[tail & UART_TX_BUFFER_MASK];
+	uart_tx_tail = tail + 1;
+}
+
+
+/** \brief Queue \p c for sending over UART.
+ *
+ * \details The byte will be stored in the transmit buffer and sent by the
+ *  USART_UDRE interrupt, so this function doesn't need to wait for the USART.
+ *  If the buffer is full, the byte will be dropped or this function blocks,
+ *  depending on \ref UART_TX_DROP. When blocking with interrupts disabled,
+ *  the buffer will be drained by polling.
+ *
+ *
+ * \param c Byte to be sent.
+ *
+ * \return If the byte has been queued true, otherwise false.
+ */
+bool
+uart_write(uint8_t c)
+{
+	uint8_t head = uart_tx_head;
+	while ((uint8_t)(head - uart_tx_tail) == UART_TX_BUFFER_SIZE) {
+#if UART_TX_DROP
+		return false;
+#else
+		if (!(SREG & _BV(SREG_I)))
+			uart_tx_poll();
+#endif
+	}
+
+	uart_tx_buffer[head & UART_TX_BUFFER_MASK] = c;
+	uart_tx_head = head + 1;
+
+	// Enable the data register empty interrupt, which will send the byte.
+	UCSR0B |= _BV(UDRIE0);
+
+	return true;
+}
+
+
+/** \brief Wait until all bytes of the transmit buffer have been handed to the
+ *  USART.
+ *
+ * \details If interrupts are disabled, the buffer will be drained by polling.
+ *  Note that the last byte may still be shifted out, when this function
+ *  returns.
+ */
+void
+uart_flush()
+{
+	while (uart_tx_tail != uart_tx_head)
+		if (!(SREG & _BV(SREG_I)))
+			uart_tx_poll();
+}
+
+
+/** \brief USART data register empty interrupt.
+ *
+ * \details Move the next byte of the transmit buffer into the USART data
+ *  register. If the buffer is empty, the interrupt disables itself, as it
+ *  would be triggered again immediately otherwise.
+ */
+ISR(USART_UDRE_vect)
+{
+	uint8_t tail = uart_tx_tail;
+	if (tail == uart_tx_head) {
+		UCSR0B &= ~_BV(UDRIE0);
+		return;
+	}
+
+	UDR0 = uart_tx_buffer[tail & UART_TX_BUFFER_MASK];
+	uart_tx_tail = tail + 1;
 }
 
 
 /** \brief Receive one byte over UART.
+ *
+ * \details This function blocks until a byte is available in the receive
+ *  buffer.
  *
  *
  * \param stream Pointer to receiving stream.
@@ -107,8 +372,174 @@ uart_putchar(char c, FILE *stream)
 int
 uart_getchar(FILE *stream)
 {
-	while (!(UCSR0A & _BV(RXC0)))
+	int c;
+	while ((c = uart_read()) < 0)
 		;
 
-	return (int)UDR0;
+	return c;
+}
+
+
+/** \brief Move the received byte into the receive buffer.
+ *
+ * \details The byte will be moved from the USART data register into the
+ *  receive buffer. If the buffer is full, the byte will be dropped and the
+ *  software overrun counter incremented.
+ */
+static inline void
+uart_rx_receive()
+{
+	// The status flags must be read before the data register.
+	if (UCSR0A & _BV(DOR0))
+		uart_rx_overruns_hw++;
+	uint8_t c = UDR0;
+
+	uint8_t head = uart_rx_head;
+	if ((uint8_t)(head - uart_rx_tail) == UART_RX_BUFFER_SIZE) {
+		uart_rx_overruns_sw++;
+		return;
+	}
+
+	uart_rx_buffer[head & UART_RX_BUFFER_MASK] = c;
+	uart_rx_head = head + 1;
+
+	uart_rts_update();
+}
+
+
+/** \brief USART receive complete interrupt.
+ */
+ISR(USART_RX_vect)
+{
+	uart_rx_receive();
+}
+
+
+/** \brief Move a byte waiting in the USART into the receive buffer.
+ *
+ * \details This function does the job of the receive interrupt, while
+ *  interrupts are disabled. It moves at most one byte, so its run time is
+ *  bounded and it may be called in short gaps of time critical code. The gaps
+ *  must not be more than one byte apart on the UART, or the USART's buffer
+ *  fills up.
+ */
+void
+uart_rx_service()
+{
+	if (UCSR0A & _BV(RXC0))
+		uart_rx_receive();
+}
+
+
+/** \brief Read one byte from the receive buffer without blocking.
+ *
+ *
+ * \return This function returns the next byte of the receive buffer or -1, if
+ *  the buffer is empty.
+ */
+int
+uart_read()
+{
+	uint8_t tail = uart_rx_tail;
+	if (tail == uart_rx_head)
+		return -1;
+
+	uint8_t c = uart_rx_buffer[tail & UART_RX_BUFFER_MASK];
+	uart_rx_tail = tail + 1;
+
+	uart_rts_sync();
+
+	return c;
+}
+
+
+/** \brief Receive one byte with interrupts disabled.
+ *
+ * \details This function first empties the receive buffer and then polls the
+ *  USART directly, so it can be used while interrupts are disabled. If no byte
+ *  arrives within about one millisecond, this function gives up.
+ *
+ *
+ * \return This function returns the received byte or -1 on timeout.
+ */
+int
+uart_poll()
+{
+	int c = uart_read();
+	if (c >= 0)
+		return c;
+
+	uint16_t timeout = UART_POLL_TIMEOUT;
+	while (!(UCSR0A & _BV(RXC0)))
+		if (!timeout--)
+			return -1;
+
+	if (UCSR0A & _BV(DOR0))
+		uart_rx_overruns_hw++;
+	return UDR0;
+}
+
+
+/** \brief Get the number of bytes waiting in the receive buffer.
+ *
+ *
+ * \return Number of bytes available to \ref uart_read.
+ */
+uint8_t
+uart_available()
+{
+	return uart_rx_head - uart_rx_tail;
+}
+
+
+/** \brief Get the free space of the receive buffer.
+ *
+ *
+ * \return Number of bytes, that may be received without dropping any.
+ */
+uint16_t
+uart_space()
+{
+	return UART_RX_BUFFER_SIZE - uart_available();
+}
+
+
+/** \brief Tell the host to pause sending.
+ *
+ * \details This function should be called before disabling interrupts for a
+ *  longer time, as the UART can't receive more than its hardware buffer then.
+ *  Without an RTS pin, this function does nothing.
+ *
+ *
+ * \param pause If true, the host should pause, otherwise it may continue.
+ */
+void
+uart_pause(bool pause)
+{
+#ifdef UART_RTS_PIN
+	uart_rts_paused = pause;
+	uart_rts_sync();
+#endif
+}
+
+
+/** \brief Get the number of dropped bytes.
+ *
+ *
+ * \param hw If true, return the number of bytes lost in the USART hardware
+ *  buffer. Otherwise return the number of bytes dropped due to a full receive
+ *  buffer.
+ *
+ * \return Number of dropped bytes since initialization.
+ */
+uint16_t
+uart_overruns(bool hw)
+{
+	uint16_t ret;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ret = hw ? uart_rx_overruns_hw : uart_rx_overruns_sw;
+	}
+
+	return ret;
 }
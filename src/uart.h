@@ -22,14 +22,33 @@
 #define LEDCONTROL_UART_H
 
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h> // FILE
 
 
+/* Baud rate for the UART connection. This is usually set by CMake. */
+#ifndef BAUD
+#define BAUD 250000UL
+#endif
+
+
 void uart_init();
 void uart_init_stdio();
 
 int uart_putchar(char c, FILE *stream);
 int uart_getchar(FILE *stream);
 
+bool uart_write(uint8_t c);
+void uart_flush();
+
+int uart_read();
+int uart_poll();
+void uart_rx_service();
+uint8_t uart_available();
+uint16_t uart_space();
+void uart_pause(bool pause);
+uint16_t uart_overruns(bool hw);
+
 
 #endif
@@ -0,0 +1,186 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#include "zone.h"
+
+#include <avr/eeprom.h>
+
+#include "config.h"
+#include "framebuffer.h"
+#include "led.h"
+#include "render.h"
+
+
+/* Zones loaded from EEPROM. */
+static ledcontrol_zone zones[LEDCONTROL_ZONE_MAX];
+
+/* Brightness of each zone, which will be applied in addition to the global
+ * brightness.
+ */
+static uint8_t brightness[LEDCONTROL_ZONE_MAX];
+
+/* ID of the zone selected for modifications. */
+static uint8_t current = LEDCONTROL_ZONE_ALL;
+
+
+/** \brief Check a zone definition.
+ *
+ *
+ * \param zone The zone to be checked.
+ *
+ * \return True if \p zone fits into the framebuffer, otherwise false.
+ */
+static bool
+ledcontrol_zone_valid(const ledcontrol_zone *zone)
+{
+	return zone->length > 0 && zone->start < LEDCONTROL_LED_MAX &&
+	       zone->length <= LEDCONTROL_LED_MAX - zone->start;
+}
+
+
+/** \brief Load all zones from EEPROM.
+ *
+ * \details Invalid zones, e.g. of erased EEPROM cells, will be undefined.
+ */
+void
+ledcontrol_zone_init()
+{
+	eeprom_read_block(zones, ledcontrol_eeprom.zones, sizeof(zones));
+
+	uint8_t i;
+	for (i = 0; i < LEDCONTROL_ZONE_MAX; i++) {
+		if (!ledcontrol_zone_valid(&zones[i]))
+			zones[i].length = 0;
+		brightness[i] = 255;
+	}
+}
+
+
+/** \brief Define zone \p id and store it in EEPROM.
+ *
+ *
+ * \param id ID of the zone.
+ * \param zone The new definition. A length of zero undefines the zone.
+ *
+ * \return True if the zone has been defined, otherwise false.
+ */
+bool
+ledcontrol_zone_configure(uint8_t id, const ledcontrol_zone *zone)
+{
+	if (id == LEDCONTROL_ZONE_ALL || id > LEDCONTROL_ZONE_MAX)
+		return false;
+	if (zone->length > 0 && !ledcontrol_zone_valid(zone))
+		return false;
+
+	zones[id - 1] = *zone;
+	eeprom_update_block(zone, &ledcontrol_eeprom.zones[id - 1],
+	                    sizeof(ledcontrol_zone));
+
+	return true;
+}
+
+
+/** \brief Select zone \p id for following modifications of the framebuffer.
+ *
+ * \details The framebuffer's window will be set to the zone, so all offsets
+ *  are relative to the zone. \ref LEDCONTROL_ZONE_ALL selects the whole strip
+ *  again.
+ *
+ *
+ * \param id ID of the zone.
+ *
+ * \return True if the zone has been selected, false if it is not defined.
+ */
+bool
+ledcontrol_zone_select(uint8_t id)
+{
+	if (id == LEDCONTROL_ZONE_ALL) {
+		ledcontrol_framebuffer_window_reset();
+		current = id;
+		return true;
+	}
+
+	if (id > LEDCONTROL_ZONE_MAX || zones[id - 1].length == 0)
+		return false;
+
+	const ledcontrol_zone *zone = &zones[id - 1];
+	ledcontrol_framebuffer_window(zone->start, zone->length,
+	                              zone->flags & LEDCONTROL_ZONE_REVERSE);
+	current = id;
+
+	return true;
+}
+
+
+/** \brief Get the ID of the selected zone.
+ *
+ *
+ * \return ID of the zone selected by \ref ledcontrol_zone_select.
+ */
+uint8_t
+ledcontrol_zone_current()
+{
+	return current;
+}
+
+
+/** \brief Set the brightness of the selected zone.
+ *
+ * \details The brightness will be applied by \ref ledcontrol_zone_render, so
+ *  the framebuffer needs to be rendered again. Setting the brightness of the
+ *  whole strip will be ignored, as this is the global brightness.
+ *
+ *
+ * \param value The new brightness. A value of 255 means the global brightness.
+ */
+void
+ledcontrol_zone_set_brightness(uint8_t value)
+{
+	if (current != LEDCONTROL_ZONE_ALL)
+		brightness[current - 1] = value;
+}
+
+
+/** \brief Apply the brightness of all zones to the rendered frame.
+ *
+ * \details Only zones with reduced brightness need to be processed, so this
+ *  costs nothing, if zone brightness is not used.
+ *
+ *
+ * \param output Pointer to the bytes rendered by \ref ledcontrol_render.
+ */
+void
+ledcontrol_zone_render(uint8_t *output)
+{
+	uint8_t i;
+	for (i = 0; i < LEDCONTROL_ZONE_MAX; i++) {
+		const ledcontrol_zone *zone = &zones[i];
+		if (zone->length == 0 || brightness[i] == 255 ||
+		    zone->start >= ledcontrol_led_count)
+			continue;
+
+		uint16_t len = ledcontrol_led_count - zone->start;
+		if (len > zone->length)
+			len = zone->length;
+
+		ledcontrol_render_dim(output + zone->start * LEDCONTROL_CHIPSET_CHANNELS,
+		                      len * LEDCONTROL_CHIPSET_CHANNELS, brightness[i]);
+	}
+}
@@ -0,0 +1,64 @@
+/* This file is part of ledcontrol.
+ *
+ * ledcontrol is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Copyright (C)
+ *  2016 Alexander Haase <ahaase@alexhaase.de>
+ */
+
+#ifndef LEDCONTROL_ZONE_H
+#define LEDCONTROL_ZONE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Maximum number of zones. Zones are addressed by the IDs 1 to
+ * LEDCONTROL_ZONE_MAX, while \ref LEDCONTROL_ZONE_ALL addresses the whole
+ * strip.
+ */
+#ifndef LEDCONTROL_ZONE_MAX
+#define LEDCONTROL_ZONE_MAX 8
+#endif
+
+#define LEDCONTROL_ZONE_ALL 0
+
+/* Flags of a zone. */
+#define LEDCONTROL_ZONE_REVERSE 0x01
+
+
+/** \brief Definition of a zone, i.e. a slice of the strip.
+ */
+typedef struct ledcontrol_zone
+{
+	/* Index of the zone's first LED. */
+	uint16_t start;
+	/* Number of LEDs in the zone. Zero for undefined zones. */
+	uint16_t length;
+	/* Flags of the zone, see LEDCONTROL_ZONE_REVERSE. */
+	uint8_t flags;
+} ledcontrol_zone;
+
+
+void ledcontrol_zone_init();
+bool ledcontrol_zone_configure(uint8_t id, const ledcontrol_zone *zone);
+bool ledcontrol_zone_select(uint8_t id);
+uint8_t ledcontrol_zone_current();
+void ledcontrol_zone_set_brightness(uint8_t value);
+void ledcontrol_zone_render(uint8_t *output);
+
+
+#endif